@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
 
 #include "acayipglobal.h"
+#include "cachemanager.h"
 #include "pixelperfectscaling_p.h"
 #include "utils_p.h"
 
@@ -54,6 +55,10 @@ static void init()
 
     QUnifiedTimer::instance()->setTimingInterval(
         1000.0 / qBound(30.0, QGuiApplication::primaryScreen()->refreshRate(), 120.0));
+
+    // Pixmaps must not outlive the application, every cache holding them is
+    // reachable through the cache manager
+    qAddPostRoutine([] { CacheManager::instance()->clear(); });
 }
 
 Q_CONSTRUCTOR_FUNCTION(prepare);
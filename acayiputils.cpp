@@ -1,4 +1,5 @@
 #include "acayiputils.h"
+#include "plugins/iconengines/pixelperfect/pixelperfecticonengine.h"
 
 #include <private/qhighdpiscaling_p.h>
 #include <qpa/qplatformscreen.h>
@@ -22,6 +23,51 @@ QColor Utils::strongerColor(QColor c, int strength)
     return c;
 }
 
+void Utils::invalidateIconFiles(const QString& filePath)
+{
+    PixelPerfectIconEngine::invalidate(filePath);
+}
+
+bool Utils::isIconFileWatcherEnabled()
+{
+    return PixelPerfectIconEngine::isFileWatcherEnabled();
+}
+
+void Utils::setIconFileWatcherEnabled(bool enabled)
+{
+    PixelPerfectIconEngine::setFileWatcherEnabled(enabled);
+}
+
+bool Utils::isIconRasterizationAsynchronous()
+{
+    return PixelPerfectIconEngine::isAsynchronous();
+}
+
+void Utils::setIconRasterizationAsynchronous(bool enabled)
+{
+    PixelPerfectIconEngine::setAsynchronous(enabled);
+}
+
+bool Utils::isIconDiskCacheEnabled()
+{
+    return PixelPerfectIconEngine::isDiskCacheEnabled();
+}
+
+void Utils::setIconDiskCacheEnabled(bool enabled)
+{
+    PixelPerfectIconEngine::setDiskCacheEnabled(enabled);
+}
+
+bool Utils::isIconDistanceFieldEnabled()
+{
+    return PixelPerfectIconEngine::isDistanceFieldEnabled();
+}
+
+void Utils::setIconDistanceFieldEnabled(bool enabled)
+{
+    PixelPerfectIconEngine::setDistanceFieldEnabled(enabled);
+}
+
 qreal Utils::scaled(const QScreen* screen, qreal value, qreal multiply)
 {
     Q_ASSERT_X(screen && screen->handle(), "AcayipWidgets", "null pointer pased");
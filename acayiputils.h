@@ -13,6 +13,16 @@ inline namespace Utils {
 
     ACAYIPWIDGETS_EXPORT QColor strongerColor(QColor color, int strength = 70);
 
+    ACAYIPWIDGETS_EXPORT void invalidateIconFiles(const QString& filePath = QString());
+    ACAYIPWIDGETS_EXPORT bool isIconFileWatcherEnabled();
+    ACAYIPWIDGETS_EXPORT void setIconFileWatcherEnabled(bool enabled);
+    ACAYIPWIDGETS_EXPORT bool isIconRasterizationAsynchronous();
+    ACAYIPWIDGETS_EXPORT void setIconRasterizationAsynchronous(bool enabled);
+    ACAYIPWIDGETS_EXPORT bool isIconDiskCacheEnabled();
+    ACAYIPWIDGETS_EXPORT void setIconDiskCacheEnabled(bool enabled);
+    ACAYIPWIDGETS_EXPORT bool isIconDistanceFieldEnabled();
+    ACAYIPWIDGETS_EXPORT void setIconDistanceFieldEnabled(bool enabled);
+
     ACAYIPWIDGETS_EXPORT qreal scaled(const QScreen* screen,
                                       qreal value,
                                       qreal multiply = 1.0);
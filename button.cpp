@@ -3,10 +3,12 @@
 
 #include "acayiputils.h"
 #include "button_p.h"
-
-#include <private/qhexstring_p.h>
+#include "cachemanager.h"
+#include "plugins/iconengines/pixelperfect/pixelperfecticonengine.h"
+#include "utils_p.h"
 
 #include <QAbstractTextDocumentLayout>
+#include <QHash>
 #include <QLayout>
 #include <QStyleHints>
 #include <QTimer>
@@ -425,6 +427,77 @@ QIcon::State ButtonPrivate::iconState() const
     return (checkable && checked) ? QIcon::On : QIcon::Off;
 }
 
+struct TintedPixmapKey
+{
+    qint64 icon;
+    QRgb color;
+    QSize size;
+    qreal devicePixelRatio;
+    QIcon::Mode mode;
+    QIcon::State state;
+
+    friend bool operator==(const TintedPixmapKey&, const TintedPixmapKey&) = default;
+};
+
+static size_t qHash(const TintedPixmapKey& key, size_t seed = 0) noexcept
+{
+    return qHashMulti(seed,
+                      key.icon,
+                      key.color,
+                      key.size.width(),
+                      key.size.height(),
+                      key.devicePixelRatio,
+                      key.mode,
+                      key.state);
+}
+
+// Every distinct set of parameters gets an id of its own, so a hash collision
+// never hands out another icon or color. Pixmaps of forgotten ids simply age
+// out of the pool
+static quint64 tintedPixmapId(const TintedPixmapKey& key)
+{
+    static QHash<TintedPixmapKey, quint64> ids;
+    static quint64 lastId = 0;
+    if (ids.size() >= 4096)
+        ids.clear();
+    auto it = ids.constFind(key);
+    if (it == ids.cend())
+        it = ids.insert(key, ++lastId);
+    return *it;
+}
+
+QPixmap ButtonPrivate::tintedPixmap(const QIcon& icon,
+                                    const QSize& size,
+                                    const QColor& color,
+                                    qreal devicePixelRatio,
+                                    QPainter::RenderHints renderHints)
+{
+    const QIcon::Mode mode = iconMode();
+    const QIcon::State state = iconState();
+    const TintedPixmapKey tintedKey{.icon = icon.cacheKey(),
+                                    .color = color.rgba(),
+                                    .size = size,
+                                    .devicePixelRatio = devicePixelRatio,
+                                    .mode = mode,
+                                    .state = state};
+    const quint64 key = tintedPixmapId(tintedKey);
+
+    QPixmap px;
+    CacheManager* cache = CacheManager::instance();
+    if (cache->find(CacheManager::TintedIconPool, key, &px))
+        return px;
+
+    px = icon.pixmap(size, devicePixelRatio, mode, state);
+    QPainter p(&px);
+    p.setRenderHints(renderHints);
+    p.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    p.fillRect(QRect(QPoint(), size), color);
+    p.end();
+
+    cache->insert(CacheManager::TintedIconPool, key, px);
+    return px;
+}
+
 Button::Button(const QString& text, const QIcon& icon, QWidget* parent)
     : Button(*new ButtonPrivate, parent)
 {
@@ -946,28 +1019,21 @@ void Button::paintEvent(QPaintEvent*)
         painter.setClipRect(iconRect);
         painter.setOpacity(o);
         if (iconColor.isValid()) {
-            const QString& cacheKey
-                = u"Acayip::Button::icon"_s
-                  % HexString<uint>(iconColor.rgba())
-                  % HexString<uint>(iconRect.width())
-                  % HexString<uint>(iconRect.height())
-                  % HexString<quint8>(d->iconMode())
-                  % HexString<quint8>(d->iconState())
-                  % HexString<quint16>(qRound(devicePixelRatio() * 1000));
-            QPixmap px;
-            if (!QPixmapCache::find(cacheKey, &px)) {
-                px = d->icon.pixmap(iconRect.size(),
-                                    devicePixelRatio(),
+            if (const PixelPerfectIconEngine* engine
+                = pixelPerfectIconEngine(d->icon)) {
+                engine->paintTinted(&painter,
+                                    iconRect,
                                     d->iconMode(),
-                                    d->iconState());
-                QPainter p(&px);
-                p.setRenderHints(painter.renderHints());
-                p.setCompositionMode(QPainter::CompositionMode_SourceIn);
-                p.fillRect(QRect(QPoint(), iconRect.size()), iconColor);
-                p.end();
-                QPixmapCache::insert(cacheKey, px);
+                                    d->iconState(),
+                                    iconColor);
+            } else {
+                const QPixmap& px = d->tintedPixmap(d->icon,
+                                                    iconRect.size(),
+                                                    iconColor,
+                                                    devicePixelRatio(),
+                                                    painter.renderHints());
+                painter.drawPixmap(iconRect, px);
             }
-            painter.drawPixmap(iconRect, px);
         } else {
             d->icon.paint(&painter,
                           iconRect,
@@ -983,28 +1049,21 @@ void Button::paintEvent(QPaintEvent*)
         painter.setClipRect(menuRect);
         painter.setOpacity(o);
         if (iconColor.isValid()) {
-            const QString& cacheKey
-                = u"Acayip::Button::menuArrow"_s
-                  % HexString<uint>(iconColor.rgba())
-                  % HexString<uint>(menuRect.width())
-                  % HexString<uint>(menuRect.height())
-                  % HexString<quint8>(d->iconMode())
-                  % HexString<quint8>(d->iconState())
-                  % HexString<quint16>(qRound(devicePixelRatio() * 1000));
-            QPixmap px;
-            if (!QPixmapCache::find(cacheKey, &px)) {
-                px = d->menuArrow.pixmap(menuRect.size(),
-                                         devicePixelRatio(),
-                                         d->iconMode(),
-                                         d->iconState());
-                QPainter p(&px);
-                p.setRenderHints(painter.renderHints());
-                p.setCompositionMode(QPainter::CompositionMode_SourceIn);
-                p.fillRect(QRect(QPoint(), menuRect.size()), iconColor);
-                p.end();
-                QPixmapCache::insert(cacheKey, px);
+            if (const PixelPerfectIconEngine* engine
+                = pixelPerfectIconEngine(d->menuArrow)) {
+                engine->paintTinted(&painter,
+                                    menuRect,
+                                    d->iconMode(),
+                                    d->iconState(),
+                                    iconColor);
+            } else {
+                const QPixmap& px = d->tintedPixmap(d->menuArrow,
+                                                    menuRect.size(),
+                                                    iconColor,
+                                                    devicePixelRatio(),
+                                                    painter.renderHints());
+                painter.drawPixmap(menuRect, px);
             }
-            painter.drawPixmap(menuRect, px);
         } else {
             d->menuArrow.paint(&painter,
                                menuRect,
@@ -14,6 +14,7 @@
 #include <private/qpushbutton_p.h>
 
 #include <QColor>
+#include <QPainter>
 #include <QPointer>
 #include <QPropertyAnimation>
 #include <QTextDocument>
@@ -47,6 +48,11 @@ public:
     void updateFont();
     QIcon::Mode iconMode() const;
     QIcon::State iconState() const;
+    QPixmap tintedPixmap(const QIcon& icon,
+                         const QSize& size,
+                         const QColor& color,
+                         qreal devicePixelRatio,
+                         QPainter::RenderHints renderHints);
 
     bool mouseAttached;
     bool hoverShadowEnabled;
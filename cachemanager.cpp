@@ -0,0 +1,134 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "cachemanager_p.h"
+#include "plugins/iconengines/pixelperfect/pixelperfecticonengine.h"
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+/*!
+ *  \internal
+*/
+CacheManagerPrivate::CacheManagerPrivate()
+{
+    // In kilobytes
+    pools[CacheManager::TintedIconPool].pixmaps.setMaxCost(8 * 1024);
+    pools[CacheManager::ShadowPool].pixmaps.setMaxCost(8 * 1024);
+    pools[CacheManager::AnimationFramePool].pixmaps.setMaxCost(32 * 1024);
+}
+
+CacheManager::CacheManager()
+    : d(new CacheManagerPrivate)
+{}
+
+CacheManager::~CacheManager()
+{
+    delete d;
+}
+
+CacheManager* CacheManager::instance()
+{
+    static CacheManager self;
+    return &self;
+}
+
+int CacheManager::budget(Pool pool) const
+{
+    if (pool == IconPool)
+        return PixelPerfectIconEngine::cacheBudget();
+    return int(d->pools[pool].pixmaps.maxCost());
+}
+
+void CacheManager::setBudget(Pool pool, int kilobytes)
+{
+    if (pool == IconPool) {
+        PixelPerfectIconEngine::setCacheBudget(kilobytes);
+        return;
+    }
+
+    CacheManagerPrivate::Pool& p = d->pools[pool];
+    const qsizetype size = p.pixmaps.size();
+    p.pixmaps.setMaxCost(qMax(0, kilobytes));
+    p.evictions += size - p.pixmaps.size();
+}
+
+CacheManager::Statistics CacheManager::statistics(Pool pool) const
+{
+    if (pool == IconPool) {
+        const PixelPerfectIconEngineCacheStatistics& s
+            = PixelPerfectIconEngine::cacheStatistics();
+        return Statistics{.hits = s.hits,
+                          .misses = s.misses,
+                          .evictions = s.evictions,
+                          .cost = s.cost,
+                          .count = s.count};
+    }
+
+    const CacheManagerPrivate::Pool& p = d->pools[pool];
+    return Statistics{.hits = p.hits,
+                      .misses = p.misses,
+                      .evictions = p.evictions,
+                      .cost = p.pixmaps.totalCost(),
+                      .count = p.pixmaps.size()};
+}
+
+void CacheManager::resetStatistics(Pool pool)
+{
+    if (pool == IconPool) {
+        PixelPerfectIconEngine::resetCacheStatistics();
+        return;
+    }
+
+    CacheManagerPrivate::Pool& p = d->pools[pool];
+    p.hits = 0;
+    p.misses = 0;
+    p.evictions = 0;
+}
+
+void CacheManager::clear(Pool pool)
+{
+    if (pool == IconPool)
+        PixelPerfectIconEngine::clearCache();
+    else
+        d->pools[pool].pixmaps.clear();
+}
+
+void CacheManager::clear()
+{
+    for (int pool = IconPool; pool <= AnimationFramePool; ++pool)
+        clear(Pool(pool));
+}
+
+bool CacheManager::find(Pool pool, quint64 key, QPixmap* pixmap)
+{
+    Q_ASSERT_X(pool != IconPool, "CacheManager", "icon rasters belong to the engine");
+    CacheManagerPrivate::Pool& p = d->pools[pool];
+    if (const QPixmap* cached = p.pixmaps.object(key)) {
+        *pixmap = *cached;
+        ++p.hits;
+        return true;
+    }
+    ++p.misses;
+    return false;
+}
+
+void CacheManager::insert(Pool pool, quint64 key, const QPixmap& pixmap)
+{
+    Q_ASSERT_X(pool != IconPool, "CacheManager", "icon rasters belong to the engine");
+    if (pool == IconPool || pixmap.isNull())
+        return;
+
+    CacheManagerPrivate::Pool& p = d->pools[pool];
+    const qsizetype cost = qsizetype(pixmap.width()) * pixmap.height() * pixmap.depth()
+                           / 8 / 1024;
+    const qsizetype size = p.pixmaps.size() + !p.pixmaps.contains(key);
+    p.pixmaps.insert(key, new QPixmap(pixmap), qMax<qsizetype>(1, cost));
+    p.evictions += size - p.pixmaps.size();
+}
+
+void CacheManager::remove(Pool pool, quint64 key)
+{
+    d->pools[pool].pixmaps.remove(key);
+}
+
+ACAYIPWIDGETS_END_NAMESPACE
@@ -0,0 +1,55 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <acayipglobal.h>
+
+#include <QPixmap>
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+class CacheManagerPrivate;
+
+/*
+ * Pixmap pools with separate budgets, each evicting its least recently used
+ * pixmaps on its own. Icon rasters are owned by the pixel perfect icon engine,
+ * the icon pool only budgets and reports them. Gui thread only.
+*/
+class ACAYIPWIDGETS_EXPORT CacheManager final
+{
+    Q_DISABLE_COPY(CacheManager)
+
+public:
+    enum Pool { IconPool, TintedIconPool, ShadowPool, AnimationFramePool };
+
+    struct Statistics
+    {
+        qint64 hits;
+        qint64 misses;
+        qint64 evictions;
+        qsizetype cost; // In kilobytes
+        qsizetype count;
+    };
+
+    static CacheManager* instance();
+
+    int budget(Pool pool) const; // In kilobytes
+    void setBudget(Pool pool, int kilobytes);
+    Statistics statistics(Pool pool) const;
+    void resetStatistics(Pool pool);
+    void clear(Pool pool);
+    void clear();
+
+    bool find(Pool pool, quint64 key, QPixmap* pixmap);
+    void insert(Pool pool, quint64 key, const QPixmap& pixmap);
+    void remove(Pool pool, quint64 key);
+
+private:
+    CacheManager();
+    ~CacheManager();
+
+    CacheManagerPrivate* d;
+};
+
+ACAYIPWIDGETS_END_NAMESPACE
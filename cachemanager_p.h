@@ -0,0 +1,34 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+/*
+ * WARNING: This file exists purely as a private implementation
+ * detail. This header file may change from version to version
+ * without notice or even be removed.
+*/
+
+#pragma once
+
+#include "cachemanager.h"
+
+#include <QCache>
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+class CacheManagerPrivate
+{
+public:
+    struct Pool
+    {
+        QCache<quint64, QPixmap> pixmaps;
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 evictions = 0;
+    };
+
+    CacheManagerPrivate();
+
+    Pool pools[CacheManager::AnimationFramePool + 1];
+};
+
+ACAYIPWIDGETS_END_NAMESPACE
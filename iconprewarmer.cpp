@@ -0,0 +1,240 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "iconprewarmer_p.h"
+#include "plugins/iconengines/pixelperfect/pixelperfecticonengine.h"
+#include "utils_p.h"
+
+#include <QAbstractButton>
+#include <QAction>
+#include <QGuiApplication>
+#include <QPointer>
+#include <QScreen>
+#include <QStyle>
+
+using namespace Qt::Literals;
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+/*!
+ *  \internal
+*/
+IconPrewarmerPrivate::IconPrewarmerPrivate()
+    : QObjectPrivate()
+    , running(false)
+    , generation(0)
+    , finishedCount(0)
+    , totalCount(0)
+    , modes({QIcon::Normal})
+{}
+
+void IconPrewarmerPrivate::init()
+{
+    Q_Q(IconPrewarmer);
+    synchronousTimer.setInterval(0);
+    QObject::connect(&synchronousTimer, &QTimer::timeout, q, [this] {
+        runNextSynchronousJob();
+    });
+}
+
+void IconPrewarmerPrivate::finishJob(int jobGeneration)
+{
+    Q_Q(IconPrewarmer);
+
+    // Left over from a cancelled run
+    if (jobGeneration != generation)
+        return;
+
+    ++finishedCount;
+    emit q->progressChanged(finishedCount, totalCount);
+
+    if (finishedCount == totalCount) {
+        running = false;
+        emit q->runningChanged(running);
+        emit q->finished();
+    }
+}
+
+// Icons of other engines can only be rasterized on the gui thread, one per
+// event loop iteration keeps a splash screen responsive
+void IconPrewarmerPrivate::runNextSynchronousJob()
+{
+    if (synchronousJobs.isEmpty()) {
+        synchronousTimer.stop();
+        return;
+    }
+
+    const Job& job = synchronousJobs.takeFirst();
+    job.icon.pixmap(job.size, job.devicePixelRatio, job.mode);
+    finishJob(generation);
+}
+
+IconPrewarmer::IconPrewarmer(QObject* parent)
+    : IconPrewarmer(*new IconPrewarmerPrivate, parent)
+{}
+
+/*!
+ *  \internal
+*/
+IconPrewarmer::IconPrewarmer(IconPrewarmerPrivate& dd, QObject* parent)
+    : QObject(dd, parent)
+{
+    Q_D(IconPrewarmer);
+    d->init();
+}
+
+void IconPrewarmer::addIcon(const QIcon& icon, const QSize& size)
+{
+    Q_D(IconPrewarmer);
+    if (!icon.isNull() && size.isValid())
+        d->requests.append({icon, size});
+}
+
+void IconPrewarmer::addIconFile(const QString& filePath, const QSize& size)
+{
+    addIcon(QIcon(filePath), size);
+}
+
+void IconPrewarmer::addWidget(const QWidget* widget)
+{
+    if (!widget)
+        return;
+
+    QList<const QWidget*> widgets{widget};
+    for (const QWidget* child : widget->findChildren<QWidget*>())
+        widgets.append(child);
+
+    for (const QWidget* w : std::as_const(widgets)) {
+        if (const QAbstractButton* button = qobject_cast<const QAbstractButton*>(w))
+            addIcon(button->icon(), button->iconSize());
+
+        const int extent = w->style()->pixelMetric(QStyle::PM_SmallIconSize,
+                                                   nullptr,
+                                                   w);
+        for (const QAction* action : w->actions())
+            addIcon(action->icon(), QSize(extent, extent));
+    }
+}
+
+void IconPrewarmer::clear()
+{
+    Q_D(IconPrewarmer);
+    d->requests.clear();
+}
+
+QList<qreal> IconPrewarmer::devicePixelRatios() const
+{
+    Q_D(const IconPrewarmer);
+    return d->devicePixelRatios;
+}
+
+// When empty, the ratios of all connected screens are used
+void IconPrewarmer::setDevicePixelRatios(const QList<qreal>& devicePixelRatios)
+{
+    Q_D(IconPrewarmer);
+    d->devicePixelRatios = devicePixelRatios;
+}
+
+QList<QIcon::Mode> IconPrewarmer::modes() const
+{
+    Q_D(const IconPrewarmer);
+    return d->modes;
+}
+
+void IconPrewarmer::setModes(const QList<QIcon::Mode>& modes)
+{
+    Q_D(IconPrewarmer);
+    d->modes = modes;
+}
+
+bool IconPrewarmer::isRunning() const
+{
+    Q_D(const IconPrewarmer);
+    return d->running;
+}
+
+int IconPrewarmer::finishedCount() const
+{
+    Q_D(const IconPrewarmer);
+    return d->finishedCount;
+}
+
+int IconPrewarmer::totalCount() const
+{
+    Q_D(const IconPrewarmer);
+    return d->totalCount;
+}
+
+void IconPrewarmer::start()
+{
+    Q_D(IconPrewarmer);
+
+    cancel();
+
+    QList<qreal> devicePixelRatios = d->devicePixelRatios;
+    if (devicePixelRatios.isEmpty()) {
+        for (const QScreen* screen : QGuiApplication::screens()) {
+            if (!devicePixelRatios.contains(screen->devicePixelRatio()))
+                devicePixelRatios.append(screen->devicePixelRatio());
+        }
+    }
+
+    const int generation = ++d->generation;
+    const QPointer<IconPrewarmer> guard(this);
+    const auto done = [guard, generation] {
+        if (guard)
+            guard->d_func()->finishJob(generation);
+    };
+
+    d->finishedCount = 0;
+    d->totalCount = 0;
+    for (const IconPrewarmerPrivate::Request& request : std::as_const(d->requests)) {
+        const PixelPerfectIconEngine* engine = pixelPerfectIconEngine(request.icon);
+        for (qreal devicePixelRatio : std::as_const(devicePixelRatios)) {
+            for (QIcon::Mode mode : std::as_const(d->modes)) {
+                ++d->totalCount;
+                if (!engine) {
+                    d->synchronousJobs.append({request.icon,
+                                               request.size,
+                                               devicePixelRatio,
+                                               mode});
+                } else if (!engine->prewarm(request.size,
+                                            devicePixelRatio,
+                                            mode,
+                                            QIcon::Off,
+                                            done)) {
+                    // Already cached
+                    ++d->finishedCount;
+                }
+            }
+        }
+    }
+
+    emit progressChanged(d->finishedCount, d->totalCount);
+    if (d->finishedCount == d->totalCount) {
+        emit finished();
+        return;
+    }
+
+    d->running = true;
+    emit runningChanged(d->running);
+    if (!d->synchronousJobs.isEmpty())
+        d->synchronousTimer.start();
+}
+
+void IconPrewarmer::cancel()
+{
+    Q_D(IconPrewarmer);
+
+    if (!d->running)
+        return;
+
+    // Rasters already on their way still land in the cache
+    ++d->generation;
+    d->synchronousJobs.clear();
+    d->synchronousTimer.stop();
+    d->running = false;
+    emit runningChanged(d->running);
+}
+
+ACAYIPWIDGETS_END_NAMESPACE
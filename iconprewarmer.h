@@ -0,0 +1,56 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <acayipglobal.h>
+
+#include <QIcon>
+#include <QObject>
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+class IconPrewarmerPrivate;
+
+class ACAYIPWIDGETS_EXPORT IconPrewarmer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(IconPrewarmer)
+    Q_DECLARE_PRIVATE(IconPrewarmer)
+
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    Q_PROPERTY(int finishedCount READ finishedCount NOTIFY progressChanged)
+    Q_PROPERTY(int totalCount READ totalCount NOTIFY progressChanged)
+
+public:
+    explicit IconPrewarmer(QObject* parent = nullptr);
+
+    void addIcon(const QIcon& icon, const QSize& size);
+    void addIconFile(const QString& filePath, const QSize& size);
+    void addWidget(const QWidget* widget);
+    void clear();
+
+    QList<qreal> devicePixelRatios() const;
+    void setDevicePixelRatios(const QList<qreal>& devicePixelRatios);
+
+    QList<QIcon::Mode> modes() const;
+    void setModes(const QList<QIcon::Mode>& modes);
+
+    bool isRunning() const;
+    int finishedCount() const;
+    int totalCount() const;
+
+signals:
+    void runningChanged(bool running);
+    void progressChanged(int finishedCount, int totalCount);
+    void finished();
+
+public slots:
+    void start();
+    void cancel();
+
+protected:
+    IconPrewarmer(IconPrewarmerPrivate& dd, QObject* parent);
+};
+
+ACAYIPWIDGETS_END_NAMESPACE
@@ -0,0 +1,55 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+/*
+ * WARNING: This file exists purely as a private implementation
+ * detail. This header file may change from version to version
+ * without notice or even be removed.
+*/
+
+#pragma once
+
+#include "iconprewarmer.h"
+
+#include <private/qobject_p.h>
+
+#include <QTimer>
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+class IconPrewarmerPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(IconPrewarmer)
+
+public:
+    struct Request
+    {
+        QIcon icon;
+        QSize size;
+    };
+
+    struct Job
+    {
+        QIcon icon;
+        QSize size;
+        qreal devicePixelRatio;
+        QIcon::Mode mode;
+    };
+
+    IconPrewarmerPrivate();
+    void init();
+    void finishJob(int generation);
+    void runNextSynchronousJob();
+
+    bool running;
+    int generation;
+    int finishedCount;
+    int totalCount;
+    QList<Request> requests;
+    QList<Job> synchronousJobs;
+    QList<qreal> devicePixelRatios;
+    QList<QIcon::Mode> modes;
+    QTimer synchronousTimer;
+};
+
+ACAYIPWIDGETS_END_NAMESPACE
@@ -0,0 +1,398 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "cachemanager.h"
+#include "lottieview_p.h"
+
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QHash>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScreen>
+#include <QStyle>
+#include <QWindow>
+
+using namespace Qt::Literals;
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+static QHash<QString, QWeakPointer<LottieFrameProvider>>& frameProviders()
+{
+    static QHash<QString, QWeakPointer<LottieFrameProvider>> providers;
+    return providers;
+}
+
+// Frame numbers go into the low half of the keys
+static quint64 nextCacheKey()
+{
+    static quint64 lastProvider = 0;
+    return ++lastProvider << 32;
+}
+
+LottieFrameProvider::LottieFrameProvider(const QString& key,
+                                         const QString& fileName,
+                                         const QSize& size,
+                                         qreal devicePixelRatio)
+    : m_key(key)
+    , m_cacheKey(nextCacheKey())
+    , m_file(fileName)
+    , m_size(size)
+    , m_devicePixelRatio(devicePixelRatio)
+    , m_frameCount(0)
+    , m_frameDelay(0)
+{
+    m_handler.setDevice(&m_file);
+    if (!m_handler.canRead())
+        return;
+
+    m_defaultSize = m_handler.option(QImageIOHandler::Size).toSize();
+    if (m_size.isValid())
+        m_handler.setOption(QImageIOHandler::ScaledSize, m_size);
+    else
+        m_size = m_defaultSize;
+    m_frameCount = m_handler.imageCount();
+    m_frameDelay = qMax(1, m_handler.nextImageDelay());
+}
+
+LottieFrameProvider::~LottieFrameProvider()
+{
+    frameProviders().remove(m_key);
+    for (int number = 0; number < m_frameCount; ++number)
+        CacheManager::instance()->remove(CacheManager::AnimationFramePool,
+                                         m_cacheKey | quint32(number));
+}
+
+QSharedPointer<LottieFrameProvider> LottieFrameProvider::acquire(
+    const QString& fileName, const QSize& size, qreal devicePixelRatio)
+{
+    const QString& filePath = QFileInfo(fileName).absoluteFilePath();
+    const QString& key = u"%1|%2x%3@%4"_s.arg(filePath)
+                             .arg(size.width())
+                             .arg(size.height())
+                             .arg(devicePixelRatio);
+
+    QSharedPointer<LottieFrameProvider> provider = frameProviders().value(key);
+    if (provider)
+        return provider;
+
+    provider.reset(new LottieFrameProvider(key, filePath, size, devicePixelRatio));
+    frameProviders().insert(key, provider);
+    return provider;
+}
+
+bool LottieFrameProvider::isValid() const
+{
+    return m_frameCount > 0;
+}
+
+QSize LottieFrameProvider::defaultSize() const
+{
+    return m_defaultSize;
+}
+
+QSize LottieFrameProvider::size() const
+{
+    return m_size;
+}
+
+qreal LottieFrameProvider::devicePixelRatio() const
+{
+    return m_devicePixelRatio;
+}
+
+int LottieFrameProvider::frameCount() const
+{
+    return m_frameCount;
+}
+
+int LottieFrameProvider::frameDelay() const
+{
+    return m_frameDelay;
+}
+
+QPixmap LottieFrameProvider::frame(int number)
+{
+    CacheManager* cache = CacheManager::instance();
+    const quint64 key = m_cacheKey | quint32(number);
+    QPixmap pixmap;
+    if (cache->find(CacheManager::AnimationFramePool, key, &pixmap))
+        return pixmap;
+
+    QImage image;
+    if (!m_handler.jumpToImage(number) || !m_handler.read(&image))
+        return QPixmap();
+
+    image.setDevicePixelRatio(m_devicePixelRatio);
+    pixmap = QPixmap::fromImage(image);
+    cache->insert(CacheManager::AnimationFramePool, key, pixmap);
+    return pixmap;
+}
+
+LottieClock::LottieClock()
+{
+    // Headless and some offscreen platforms have no screen
+    const QScreen* screen = QGuiApplication::primaryScreen();
+    const qreal refreshRate = screen ? screen->refreshRate() : 60.0;
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setInterval(1000.0 / qBound(30.0, refreshRate, 120.0));
+    m_elapsedTimer.start();
+    QObject::connect(&m_timer, &QTimer::timeout, [this] {
+        const qint64 elapsed = m_elapsedTimer.elapsed();
+        // Views may unsubscribe while ticking
+        const QSet<LottieViewPrivate*> views = m_views;
+        for (LottieViewPrivate* view : views)
+            view->tick(elapsed);
+    });
+    // The timer must not outlive the application
+    qAddPostRoutine([] {
+        LottieClock* clock = LottieClock::instance();
+        clock->m_timer.stop();
+        clock->m_views.clear();
+    });
+}
+
+LottieClock* LottieClock::instance()
+{
+    static LottieClock self;
+    return &self;
+}
+
+void LottieClock::subscribe(LottieViewPrivate* view)
+{
+    m_views.insert(view);
+    if (!m_timer.isActive())
+        m_timer.start();
+    view->tick(m_elapsedTimer.elapsed());
+}
+
+void LottieClock::unsubscribe(LottieViewPrivate* view)
+{
+    m_views.remove(view);
+    if (m_views.isEmpty())
+        m_timer.stop();
+}
+
+/*!
+ *  \internal
+*/
+LottieViewPrivate::LottieViewPrivate()
+    : QWidgetPrivate()
+    , playing(true)
+    , subscribed(false)
+    , currentFrame(0)
+{}
+
+LottieViewPrivate::~LottieViewPrivate()
+{
+    if (subscribed)
+        LottieClock::instance()->unsubscribe(this);
+}
+
+QRect LottieViewPrivate::frameRect() const
+{
+    Q_Q(const LottieView);
+    if (!provider)
+        return QRect();
+    const QRect& contents = q->contentsRect();
+    const QSize& size = provider->defaultSize().scaled(contents.size(),
+                                                       Qt::KeepAspectRatio);
+    return QStyle::alignedRect(q->layoutDirection(), Qt::AlignCenter, size, contents);
+}
+
+bool LottieViewPrivate::isOnScreen() const
+{
+    Q_Q(const LottieView);
+
+    if (!q->isVisible())
+        return false;
+
+    const QWidget* window = q->window();
+    if (window->isMinimized())
+        return false;
+
+    const QWindow* handle = window->windowHandle();
+    if (handle && !handle->isExposed())
+        return false;
+
+    // Covers the views scrolled out of their viewports
+    return !q->visibleRegion().isEmpty();
+}
+
+void LottieViewPrivate::ensureProvider()
+{
+    Q_Q(LottieView);
+
+    if (!provider)
+        return;
+
+    const qreal dpr = q->devicePixelRatioF();
+    const QSize& size = frameRect().size() * dpr;
+    if (size.isEmpty())
+        return;
+
+    if (provider->size() != size || !qFuzzyCompare(provider->devicePixelRatio(), dpr))
+        provider = LottieFrameProvider::acquire(fileName, size, dpr);
+}
+
+void LottieViewPrivate::updateSubscription()
+{
+    const bool subscribe = playing && provider && provider->frameCount() > 1
+                           && isOnScreen();
+    if (subscribe == subscribed)
+        return;
+
+    subscribed = subscribe;
+    if (subscribed)
+        LottieClock::instance()->subscribe(this);
+    else
+        LottieClock::instance()->unsubscribe(this);
+}
+
+void LottieViewPrivate::tick(qint64 elapsed)
+{
+    Q_Q(LottieView);
+
+    // Nothing notifies us when we get scrolled away or the window gets
+    // minimized, the next paint event after that brings the subscription back
+    if (!isOnScreen()) {
+        updateSubscription();
+        return;
+    }
+
+    const int frame = (elapsed / provider->frameDelay()) % provider->frameCount();
+    if (frame == currentFrame)
+        return;
+
+    currentFrame = frame;
+    q->update(frameRect());
+    emit q->frameChanged(currentFrame);
+}
+
+LottieView::LottieView(QWidget* parent)
+    : LottieView(*new LottieViewPrivate, parent)
+{}
+
+LottieView::LottieView(const QString& fileName, QWidget* parent)
+    : LottieView(*new LottieViewPrivate, parent)
+{
+    setFileName(fileName);
+}
+
+/*!
+ *  \internal
+*/
+LottieView::LottieView(LottieViewPrivate& dd, QWidget* parent)
+    : QWidget(dd, parent, Qt::WindowFlags())
+{}
+
+QString LottieView::fileName() const
+{
+    Q_D(const LottieView);
+    return d->fileName;
+}
+
+void LottieView::setFileName(const QString& fileName)
+{
+    Q_D(LottieView);
+
+    if (d->fileName == fileName)
+        return;
+
+    d->fileName = fileName;
+    d->currentFrame = 0;
+    d->provider.reset();
+    if (!fileName.isEmpty()) {
+        d->provider = LottieFrameProvider::acquire(fileName, QSize(), 1.0);
+        if (!d->provider->isValid()) {
+            qWarning("LottieView: Cannot load %s", qUtf8Printable(fileName));
+            d->provider.reset();
+        }
+    }
+
+    d->updateSubscription();
+    updateGeometry();
+    update();
+}
+
+bool LottieView::isPlaying() const
+{
+    Q_D(const LottieView);
+    return d->playing;
+}
+
+void LottieView::setPlaying(bool playing)
+{
+    Q_D(LottieView);
+    d->playing = playing;
+    d->updateSubscription();
+}
+
+int LottieView::frameCount() const
+{
+    Q_D(const LottieView);
+    return d->provider ? d->provider->frameCount() : 0;
+}
+
+int LottieView::currentFrame() const
+{
+    Q_D(const LottieView);
+    return d->currentFrame;
+}
+
+QSize LottieView::sizeHint() const
+{
+    Q_D(const LottieView);
+    if (!d->provider)
+        return QWidget::sizeHint();
+    return d->provider->defaultSize().grownBy(contentsMargins());
+}
+
+void LottieView::play()
+{
+    setPlaying(true);
+}
+
+void LottieView::pause()
+{
+    setPlaying(false);
+}
+
+bool LottieView::event(QEvent* event)
+{
+    Q_D(LottieView);
+
+    switch (event->type()) {
+    case QEvent::Show:
+    case QEvent::Hide:
+    case QEvent::ParentChange:
+    case QEvent::WindowStateChange:
+        d->updateSubscription();
+        break;
+    default:
+        break;
+    }
+
+    return QWidget::event(event);
+}
+
+void LottieView::paintEvent(QPaintEvent*)
+{
+    Q_D(LottieView);
+
+    // Getting painted means we are on screen again
+    d->updateSubscription();
+    d->ensureProvider();
+    if (!d->provider)
+        return;
+
+    const QPixmap& pixmap = d->provider->frame(d->currentFrame);
+    if (pixmap.isNull())
+        return;
+
+    QPainter painter(this);
+    painter.setRenderHints(Defaults::renderHints);
+    painter.drawPixmap(d->frameRect(), pixmap);
+}
+
+ACAYIPWIDGETS_END_NAMESPACE
@@ -0,0 +1,54 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <acayipglobal.h>
+
+#include <QWidget>
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+class LottieViewPrivate;
+
+class ACAYIPWIDGETS_EXPORT LottieView : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(LottieView)
+    Q_DECLARE_PRIVATE(LottieView)
+
+    Q_PROPERTY(QString fileName READ fileName WRITE setFileName)
+    Q_PROPERTY(bool playing READ isPlaying WRITE setPlaying)
+    Q_PROPERTY(int currentFrame READ currentFrame NOTIFY frameChanged)
+
+public:
+    explicit LottieView(QWidget* parent = nullptr);
+    explicit LottieView(const QString& fileName, QWidget* parent = nullptr);
+
+    QString fileName() const;
+    void setFileName(const QString& fileName);
+
+    bool isPlaying() const;
+    void setPlaying(bool playing);
+
+    int frameCount() const;
+    int currentFrame() const;
+
+    QSize sizeHint() const override;
+
+signals:
+    void frameChanged(int frame);
+
+public slots:
+    void play();
+    void pause();
+
+protected:
+    bool event(QEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+
+protected:
+    LottieView(LottieViewPrivate& dd, QWidget* parent);
+};
+
+ACAYIPWIDGETS_END_NAMESPACE
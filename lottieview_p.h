@@ -0,0 +1,109 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+/*
+ * WARNING: This file exists purely as a private implementation
+ * detail. This header file may change from version to version
+ * without notice or even be removed.
+*/
+
+#pragma once
+
+#include "lottieview.h"
+
+#include <lottieiohandler.h>
+
+#include <private/qwidget_p.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPixmap>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTimer>
+
+ACAYIPWIDGETS_BEGIN_NAMESPACE
+
+/*
+ * Renders and keeps the frames of one file at one device size, views showing
+ * the same file at the same size share a single provider
+*/
+class LottieFrameProvider final
+{
+    Q_DISABLE_COPY(LottieFrameProvider)
+
+public:
+    ~LottieFrameProvider();
+
+    static QSharedPointer<LottieFrameProvider> acquire(const QString& fileName,
+                                                       const QSize& size,
+                                                       qreal devicePixelRatio);
+
+    bool isValid() const;
+    QSize defaultSize() const;
+    QSize size() const;
+    qreal devicePixelRatio() const;
+    int frameCount() const;
+    int frameDelay() const;
+    QPixmap frame(int number);
+
+private:
+    LottieFrameProvider(const QString& key,
+                        const QString& fileName,
+                        const QSize& size,
+                        qreal devicePixelRatio);
+
+    QString m_key;
+    quint64 m_cacheKey;
+    QFile m_file;
+    LottieIOHandler m_handler;
+    QSize m_defaultSize;
+    QSize m_size;
+    qreal m_devicePixelRatio;
+    int m_frameCount;
+    int m_frameDelay;
+};
+
+/*
+ * One timer for every playing view, frames are derived from the same elapsed
+ * time so that views showing the same animation stay in step
+*/
+class LottieClock final
+{
+    Q_DISABLE_COPY(LottieClock)
+
+public:
+    static LottieClock* instance();
+
+    void subscribe(LottieViewPrivate* view);
+    void unsubscribe(LottieViewPrivate* view);
+
+private:
+    LottieClock();
+
+    QTimer m_timer;
+    QElapsedTimer m_elapsedTimer;
+    QSet<LottieViewPrivate*> m_views;
+};
+
+class LottieViewPrivate : public QWidgetPrivate
+{
+    Q_DECLARE_PUBLIC(LottieView)
+
+public:
+    LottieViewPrivate();
+    ~LottieViewPrivate() override;
+    QRect frameRect() const;
+    bool isOnScreen() const;
+    void ensureProvider();
+    void updateSubscription();
+    void tick(qint64 elapsed);
+
+    bool playing;
+    bool subscribed;
+    int currentFrame;
+    QString fileName;
+    QSharedPointer<LottieFrameProvider> provider;
+};
+
+ACAYIPWIDGETS_END_NAMESPACE
@@ -0,0 +1,397 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "pixelperfecticonengine.h"
+
+#include <QDir>
+#include <QFile>
+#include <QGuiApplication>
+#include <QPainter>
+#include <QStyleHints>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+using namespace Qt::Literals;
+
+static constexpr int schemeEngineCount = 64;
+
+static QString svgIcon(int size, const QString& color)
+{
+    const QString& svg
+        = uR"(<svg xmlns="http://www.w3.org/2000/svg" width="%1" height="%1" )"
+          uR"(viewBox="0 0 16 16"><path fill="%2" d="M8 1l2.2 4.6 5 .7-3.6 3.5.9 5)"
+          uR"(L8 12.4l-4.5 2.4.9-5L.8 6.3l5-.7z"/><circle cx="8" cy="8" r="2" )"
+          uR"(fill="none" stroke="%2"/></svg>)"_s;
+    return svg.arg(size).arg(color);
+}
+
+static QImage pngIcon(int size, const QColor& color)
+{
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(color);
+    painter.drawEllipse(QRectF(image.rect()).adjusted(1, 1, -1, -1));
+    painter.setBrush(color.lighter(150));
+    painter.drawRect(QRectF(size / 4.0, size / 4.0, size / 2.0, size / 2.0));
+    painter.end();
+    return image;
+}
+
+static bool writeFile(const QString& filePath, const QString& contents)
+{
+    QFile file(filePath);
+    return file.open(QIODevice::WriteOnly) && file.write(contents.toUtf8()) >= 0;
+}
+
+// Paints into an image of the given logical extent and pixel ratio
+class Canvas
+{
+public:
+    Canvas(int extent, qreal devicePixelRatio)
+        : m_image(QSize(extent, extent) * devicePixelRatio,
+                  QImage::Format_ARGB32_Premultiplied)
+        , m_rect(0, 0, extent, extent)
+    {
+        m_image.setDevicePixelRatio(devicePixelRatio);
+        m_image.fill(Qt::transparent);
+        m_painter.begin(&m_image);
+    }
+
+    QPainter* painter() { return &m_painter; }
+    QRect rect() const { return m_rect; }
+
+private:
+    QImage m_image;
+    QRect m_rect;
+    QPainter m_painter;
+};
+
+// Takes updates like a widget does, so engines painting into it rasterize the
+// sizes painted for the next color scheme before switching to it
+class UpdatedImage : public QObject, public QImage
+{
+    Q_OBJECT
+
+public:
+    using QImage::QImage;
+
+    int updateCount() const { return m_updateCount; }
+    Q_INVOKABLE void update() { ++m_updateCount; }
+
+private:
+    int m_updateCount = 0;
+};
+
+/*
+ * Synthetic SVG and PNG variant sets, light and dark, at 100%, 150%, 200% and
+ * 300% are written to a temporary directory at start. Cold paints clear the
+ * pixmap caches on every iteration, parsed documents and mip chains stay.
+*/
+class tst_bench_PixelPerfectIconEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void construction_data();
+    void construction();
+    void paintCold_data();
+    void paintCold();
+    void paintWarm_data();
+    void paintWarm();
+    void paintTinted_data();
+    void paintTinted();
+    void modes_data();
+    void modes();
+    void colorSchemeSwitch_data();
+    void colorSchemeSwitch();
+
+private:
+    void addPaintRows();
+    QString iconPath(const QString& format) const;
+
+    QTemporaryDir m_dir;
+};
+
+void tst_bench_PixelPerfectIconEngine::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    const QDir dir(m_dir.path());
+    QVERIFY(dir.mkpath(u"svg"_s));
+    QVERIFY(dir.mkpath(u"png"_s));
+
+    for (int dpi : {100, 150, 200, 300}) {
+        const int size = 16 * dpi / 100;
+        const QString& infix = dpi == 100 ? QString() : u".%1"_s.arg(dpi);
+        QVERIFY(writeFile(dir.filePath(u"svg/icon%1.svg"_s.arg(infix)),
+                          svgIcon(size, u"#202020"_s)));
+        QVERIFY(writeFile(dir.filePath(u"svg/icon.dark%1.svg"_s.arg(infix)),
+                          svgIcon(size, u"#f0f0f0"_s)));
+        QVERIFY(pngIcon(size, QColor(0x20, 0x20, 0x20))
+                    .save(dir.filePath(u"png/icon%1.png"_s.arg(infix))));
+        QVERIFY(pngIcon(size, QColor(0xf0, 0xf0, 0xf0))
+                    .save(dir.filePath(u"png/icon.dark%1.png"_s.arg(infix))));
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::cleanup()
+{
+    PixelPerfectIconEngine::clearCache();
+}
+
+void tst_bench_PixelPerfectIconEngine::construction_data()
+{
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<bool>("cold");
+
+    for (const char* format : {"svg", "png"}) {
+        QTest::addRow("%s-warm", format) << QString::fromLatin1(format) << false;
+        QTest::addRow("%s-cold", format) << QString::fromLatin1(format) << true;
+    }
+}
+
+// Cold runs scan the directory and read the file headers again
+void tst_bench_PixelPerfectIconEngine::construction()
+{
+    QFETCH(QString, format);
+    QFETCH(bool, cold);
+
+    // The first engine of a directory always scans it
+    const QString& filePath = iconPath(format);
+    QVERIFY(!PixelPerfectIconEngine(filePath).isNull());
+
+    QBENCHMARK {
+        if (cold)
+            PixelPerfectIconEngine::invalidate();
+        PixelPerfectIconEngine engine(filePath);
+        Q_UNUSED(engine)
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::paintCold_data()
+{
+    addPaintRows();
+}
+
+void tst_bench_PixelPerfectIconEngine::paintCold()
+{
+    QFETCH(QString, format);
+    QFETCH(int, extent);
+    QFETCH(qreal, devicePixelRatio);
+
+    PixelPerfectIconEngine engine(iconPath(format));
+    Canvas canvas(extent, devicePixelRatio);
+    engine.paint(canvas.painter(), canvas.rect(), QIcon::Normal, QIcon::Off);
+
+    QBENCHMARK {
+        PixelPerfectIconEngine::clearCache();
+        engine.paint(canvas.painter(), canvas.rect(), QIcon::Normal, QIcon::Off);
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::paintWarm_data()
+{
+    addPaintRows();
+}
+
+void tst_bench_PixelPerfectIconEngine::paintWarm()
+{
+    QFETCH(QString, format);
+    QFETCH(int, extent);
+    QFETCH(qreal, devicePixelRatio);
+
+    PixelPerfectIconEngine engine(iconPath(format));
+    Canvas canvas(extent, devicePixelRatio);
+    engine.paint(canvas.painter(), canvas.rect(), QIcon::Normal, QIcon::Off);
+
+    QBENCHMARK {
+        engine.paint(canvas.painter(), canvas.rect(), QIcon::Normal, QIcon::Off);
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::paintTinted_data()
+{
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<int>("extent");
+    QTest::addColumn<qreal>("devicePixelRatio");
+    QTest::addColumn<bool>("cold");
+
+    for (const char* format : {"svg", "png"}) {
+        for (int extent : {16, 32}) {
+            for (qreal devicePixelRatio : {1.0, 2.0}) {
+                for (bool cold : {false, true}) {
+                    QTest::addRow("%s-%d@%gx-%s",
+                                  format,
+                                  extent,
+                                  devicePixelRatio,
+                                  cold ? "cold" : "warm")
+                        << QString::fromLatin1(format) << extent << devicePixelRatio
+                        << cold;
+                }
+            }
+        }
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::paintTinted()
+{
+    QFETCH(QString, format);
+    QFETCH(int, extent);
+    QFETCH(qreal, devicePixelRatio);
+    QFETCH(bool, cold);
+
+    const QColor color(0x30, 0x80, 0xe0);
+    PixelPerfectIconEngine engine(iconPath(format));
+    Canvas canvas(extent, devicePixelRatio);
+    engine.paintTinted(canvas.painter(),
+                       canvas.rect(),
+                       QIcon::Normal,
+                       QIcon::Off,
+                       color);
+
+    QBENCHMARK {
+        if (cold)
+            PixelPerfectIconEngine::clearCache();
+        engine.paintTinted(canvas.painter(),
+                           canvas.rect(),
+                           QIcon::Normal,
+                           QIcon::Off,
+                           color);
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::modes_data()
+{
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<qreal>("devicePixelRatio");
+    QTest::addColumn<int>("mode");
+
+    const std::pair<const char*, QIcon::Mode> modes[] = {
+        {"normal", QIcon::Normal},
+        {"active", QIcon::Active},
+        {"disabled", QIcon::Disabled},
+        {"selected", QIcon::Selected},
+    };
+    for (const char* format : {"svg", "png"}) {
+        for (qreal devicePixelRatio : {1.0, 2.0}) {
+            for (const auto& [name, mode] : modes) {
+                QTest::addRow("%s-32@%gx-%s", format, devicePixelRatio, name)
+                    << QString::fromLatin1(format) << devicePixelRatio << int(mode);
+            }
+        }
+    }
+}
+
+// Every iteration paints the normal mode first, as widgets do, so the normal
+// rows are the baseline the generated modes are compared against
+void tst_bench_PixelPerfectIconEngine::modes()
+{
+    QFETCH(QString, format);
+    QFETCH(qreal, devicePixelRatio);
+    QFETCH(int, mode);
+
+    PixelPerfectIconEngine engine(iconPath(format));
+    Canvas canvas(32, devicePixelRatio);
+
+    QBENCHMARK {
+        PixelPerfectIconEngine::clearCache();
+        engine.paint(canvas.painter(), canvas.rect(), QIcon::Normal, QIcon::Off);
+        engine.paint(canvas.painter(), canvas.rect(), QIcon::Mode(mode), QIcon::Off);
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::colorSchemeSwitch_data()
+{
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<bool>("cold");
+
+    for (const char* format : {"svg", "png"}) {
+        QTest::addRow("%s-warm", format) << QString::fromLatin1(format) << false;
+        QTest::addRow("%s-cold", format) << QString::fromLatin1(format) << true;
+    }
+}
+
+// Engines rasterize the size they were painted at for the new scheme and only
+// switch once it's there, like in widgets. Cold runs rasterize on the pool
+void tst_bench_PixelPerfectIconEngine::colorSchemeSwitch()
+{
+    QFETCH(QString, format);
+    QFETCH(bool, cold);
+
+    std::vector<std::unique_ptr<PixelPerfectIconEngine>> engines;
+    for (int i = 0; i < schemeEngineCount; ++i)
+        engines.push_back(std::make_unique<PixelPerfectIconEngine>(iconPath(format)));
+
+    const qreal devicePixelRatio = 1.5;
+    UpdatedImage image(QSize(24, 24) * devicePixelRatio,
+                       QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    const auto paintAll = [&] {
+        for (const std::unique_ptr<PixelPerfectIconEngine>& engine : engines)
+            engine->paint(&painter, QRect(0, 0, 24, 24), QIcon::Normal, QIcon::Off);
+    };
+
+    // Every engine updates the image once when it has switched
+    QStyleHints* styleHints = QGuiApplication::styleHints();
+    const auto switchTo = [&](Qt::ColorScheme colorScheme) {
+        if (cold)
+            PixelPerfectIconEngine::clearCache();
+        const int updateCount = image.updateCount() + schemeEngineCount;
+        emit styleHints->colorSchemeChanged(colorScheme);
+        if (!QTest::qWaitFor([&] { return image.updateCount() >= updateCount; }))
+            return false;
+        paintAll();
+        return true;
+    };
+
+    paintAll();
+    QVERIFY(switchTo(Qt::ColorScheme::Dark));
+    QVERIFY(switchTo(Qt::ColorScheme::Light));
+
+    QBENCHMARK {
+        QVERIFY(switchTo(Qt::ColorScheme::Dark));
+        QVERIFY(switchTo(Qt::ColorScheme::Light));
+    }
+}
+
+void tst_bench_PixelPerfectIconEngine::addPaintRows()
+{
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<int>("extent");
+    QTest::addColumn<qreal>("devicePixelRatio");
+
+    for (const char* format : {"svg", "png"}) {
+        for (int extent : {16, 24, 32, 48, 64}) {
+            for (qreal devicePixelRatio : {1.0, 1.25, 1.5, 2.0}) {
+                QTest::addRow("%s-%d@%gx", format, extent, devicePixelRatio)
+                    << QString::fromLatin1(format) << extent << devicePixelRatio;
+            }
+        }
+    }
+}
+
+QString tst_bench_PixelPerfectIconEngine::iconPath(const QString& format) const
+{
+    return QDir(m_dir.path()).filePath(u"%1/icon.%1"_s.arg(format));
+}
+
+int main(int argc, char* argv[])
+{
+    // Rasterization needs fonts but no display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    tst_bench_PixelPerfectIconEngine test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_bench_pixelperfecticonengine.moc"
@@ -0,0 +1,71 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "pixelperfecticonbundle.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+
+using namespace Qt::Literals;
+
+int main(int argc, char* argv[])
+{
+    // Svg files are measured and rasterized through the image format plugins,
+    // which need fonts but no display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QGuiApplication::setApplicationName(u"pixelperfectbundler"_s);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        u"Packs a directory of icons and their variants into a single bundle."_s);
+    parser.addHelpOption();
+    parser.addPositionalArgument(u"source"_s, u"The directory of icons to pack."_s);
+    parser.addPositionalArgument(u"output"_s, u"The bundle file to write."_s);
+
+    const QCommandLineOption rasterizeOption(
+        u"rasterize"_s,
+        u"Store premultiplied rasters of every file at its own size."_s);
+    const QCommandLineOption filterOption({u"f"_s, u"filter"_s},
+                                          u"File name filter, may be repeated."_s,
+                                          u"pattern"_s);
+    parser.addOptions({rasterizeOption, filterOption});
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 2)
+        parser.showHelp(1);
+
+    const QString& source = parser.positionalArguments().at(0);
+    const QString& output = parser.positionalArguments().at(1);
+    const QDir dir(source);
+    if (!dir.exists()) {
+        qWarning("No such directory: %s", qUtf8Printable(source));
+        return 1;
+    }
+
+    QStringList sourceFilePaths;
+    const QStringList& fileNames = dir.entryList(parser.values(filterOption),
+                                                 QDir::Files);
+    for (const QString& fileName : fileNames)
+        sourceFilePaths.append(dir.absoluteFilePath(fileName));
+
+    QElapsedTimer timer;
+    timer.start();
+    QString errorString;
+    if (!PixelPerfectIconBundle::write(output,
+                                       sourceFilePaths,
+                                       parser.isSet(rasterizeOption),
+                                       &errorString)) {
+        qWarning("%s", qUtf8Printable(errorString));
+        return 1;
+    }
+
+    qInfo("Packed %lld files into %s in %lld ms",
+          qlonglong(sourceFilePaths.size()),
+          qUtf8Printable(output),
+          timer.elapsed());
+    return 0;
+}
@@ -4,7 +4,6 @@
 #include "pixelperfecticonengine.h"
 
 #include <QIconEnginePlugin>
-#include <QPixmapCache>
 
 class PixelPerfectIconEnginePlugin final : public QIconEnginePlugin
 {
@@ -13,15 +12,10 @@ class PixelPerfectIconEnginePlugin final : public QIconEnginePlugin
     Q_PLUGIN_METADATA(IID QIconEngineFactoryInterface_iid FILE "pixelperfect.json")
 
 public:
-    PixelPerfectIconEnginePlugin();
+    PixelPerfectIconEnginePlugin() = default;
     QIconEngine* create(const QString& filePath) override;
 };
 
-PixelPerfectIconEnginePlugin::PixelPerfectIconEnginePlugin()
-{
-    QPixmapCache::setCacheLimit(102400); // Set pixmap cache to 100 Mb
-}
-
 QIconEngine* PixelPerfectIconEnginePlugin::create(const QString& filePath)
 {
     return new PixelPerfectIconEngine(filePath);
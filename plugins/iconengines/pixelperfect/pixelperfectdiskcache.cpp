@@ -0,0 +1,263 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "pixelperfectdiskcache.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+using namespace Qt::Literals;
+
+static constexpr quint32 packMagic = 0x41574943; // AWIC
+static constexpr quint32 packVersion = 1;
+static constexpr qint64 maxPackSize = 64 * 1024 * 1024;
+static constexpr qint64 dataAlignment = 16;
+
+static qint64 aligned(qint64 offset)
+{
+    return (offset + dataAlignment - 1) & ~(dataAlignment - 1);
+}
+
+PixelPerfectDiskCache::PixelPerfectDiskCache()
+    : m_enabled(false)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_records(nullptr)
+    , m_count(0)
+    , m_pendingSize(0)
+{
+    qAddPostRoutine([] { PixelPerfectDiskCache::instance()->flush(); });
+}
+
+PixelPerfectDiskCache* PixelPerfectDiskCache::instance()
+{
+    static PixelPerfectDiskCache self;
+    return &self;
+}
+
+bool PixelPerfectDiskCache::isEnabled() const
+{
+    return m_enabled;
+}
+
+void PixelPerfectDiskCache::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+
+    m_enabled = enabled;
+    if (m_enabled) {
+        open();
+    } else {
+        flush();
+        close();
+    }
+}
+
+bool PixelPerfectDiskCache::find(quint64 key, QImage* image)
+{
+    if (!m_enabled)
+        return false;
+
+    if (auto it = m_pending.constFind(key); it != m_pending.cend()) {
+        *image = *it;
+        return true;
+    }
+
+    const Record* r = record(key);
+    if (!r)
+        return false;
+
+    // Copied out of the mapping, pixmaps made from it may share its pixels and
+    // outlive the mapping when the pack is flushed or disabled
+    m_used.insert(key);
+    *image = QImage(m_data + r->offset,
+                    r->width,
+                    r->height,
+                    r->bytesPerLine,
+                    QImage::Format_ARGB32_Premultiplied)
+                 .copy();
+    return true;
+}
+
+// Collects no more than a pack holds, the rest would only be dropped on flush
+void PixelPerfectDiskCache::insert(quint64 key, const QImage& image)
+{
+    if (!m_enabled || image.isNull() || m_pending.contains(key) || record(key))
+        return;
+
+    const QImage& converted = image.convertToFormat(
+        QImage::Format_ARGB32_Premultiplied);
+    const qint64 size = qint64(sizeof(Record)) + dataAlignment
+                        + converted.sizeInBytes();
+    if (qint64(sizeof(Header)) + m_pendingSize + size > maxPackSize)
+        return;
+    m_pendingSize += size;
+    m_pending.insert(key, converted);
+}
+
+void PixelPerfectDiskCache::flush()
+{
+    if (m_pending.isEmpty())
+        return;
+
+    struct Item
+    {
+        quint64 key;
+        const uchar* bits;
+        quint32 width;
+        quint32 height;
+        quint32 bytesPerLine;
+    };
+
+    // New rasters first, then the ones used by this session, then the rest
+    QList<Item> items;
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+        items.append(Item{.key = it.key(),
+                          .bits = it->constBits(),
+                          .width = quint32(it->width()),
+                          .height = quint32(it->height()),
+                          .bytesPerLine = quint32(it->bytesPerLine())});
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (quint32 i = 0; i < m_count; ++i) {
+            const Record& r = m_records[i];
+            if (m_used.contains(r.key) != (pass == 0) || m_pending.contains(r.key))
+                continue;
+            items.append(Item{.key = r.key,
+                              .bits = m_data + r.offset,
+                              .width = r.width,
+                              .height = r.height,
+                              .bytesPerLine = r.bytesPerLine});
+        }
+    }
+
+    qint64 size = sizeof(Header);
+    qsizetype count = 0;
+    for (const Item& item : std::as_const(items)) {
+        const qint64 itemSize = sizeof(Record) + dataAlignment
+                                + qint64(item.bytesPerLine) * item.height;
+        if (size + itemSize > maxPackSize)
+            break;
+        size += itemSize;
+        ++count;
+    }
+    items.resize(count);
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return a.key < b.key;
+    });
+
+    QDir().mkpath(QFileInfo(filePath()).absolutePath());
+    QSaveFile file(filePath());
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    const Header header{.magic = packMagic,
+                        .version = packVersion,
+                        .count = quint32(items.size()),
+                        .reserved = 0};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    qint64 offset = aligned(sizeof(Header) + items.size() * sizeof(Record));
+    for (const Item& item : std::as_const(items)) {
+        const Record r{.key = item.key,
+                       .offset = quint64(offset),
+                       .width = item.width,
+                       .height = item.height,
+                       .bytesPerLine = item.bytesPerLine,
+                       .reserved = 0};
+        file.write(reinterpret_cast<const char*>(&r), sizeof(r));
+        offset = aligned(offset + qint64(item.bytesPerLine) * item.height);
+    }
+
+    static const QByteArray padding(dataAlignment, '\0');
+    for (const Item& item : std::as_const(items)) {
+        file.write(padding.constData(), aligned(file.pos()) - file.pos());
+        file.write(reinterpret_cast<const char*>(item.bits),
+                   qint64(item.bytesPerLine) * item.height);
+    }
+
+    // The mapping has to go before the file can be replaced
+    close();
+    file.commit();
+    m_pending.clear();
+    m_pendingSize = 0;
+    m_used.clear();
+    if (m_enabled)
+        open();
+}
+
+QString PixelPerfectDiskCache::filePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + "/acayipwidgets/icons.pack"_L1;
+}
+
+void PixelPerfectDiskCache::open()
+{
+    close();
+
+    m_file.setFileName(filePath());
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(Header))) {
+        close();
+        return;
+    }
+
+    const uchar* data = m_file.map(0, m_file.size());
+    if (!data) {
+        close();
+        return;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (header->magic != packMagic || header->version != packVersion
+        || qint64(sizeof(Header) + header->count * sizeof(Record)) > m_file.size()) {
+        m_file.unmap(const_cast<uchar*>(data));
+        close();
+        return;
+    }
+
+    m_data = data;
+    m_size = m_file.size();
+    m_records = reinterpret_cast<const Record*>(data + sizeof(Header));
+    m_count = header->count;
+}
+
+void PixelPerfectDiskCache::close()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+    m_file.close();
+    m_data = nullptr;
+    m_size = 0;
+    m_records = nullptr;
+    m_count = 0;
+}
+
+const PixelPerfectDiskCache::Record* PixelPerfectDiskCache::record(quint64 key) const
+{
+    const Record* end = m_records + m_count;
+    const Record* r = std::lower_bound(m_records,
+                                       end,
+                                       key,
+                                       [](const Record& r, quint64 key) {
+                                           return r.key < key;
+                                       });
+    if (r == end || r->key != key)
+        return nullptr;
+
+    // Truncated or corrupt packs are treated as misses
+    // Compared one by one, sums of corrupt fields could wrap around
+    const quint64 size = quint64(m_size);
+    if (r->offset % dataAlignment != 0 || r->bytesPerLine < quint64(r->width) * 4
+        || r->offset > size
+        || quint64(r->bytesPerLine) * r->height > size - r->offset) {
+        return nullptr;
+    }
+    return r;
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+
+/*
+ * Keeps premultiplied rasters across launches in a single pack file: a header,
+ * an index sorted by key and the pixel data. The file is mapped and looked up
+ * in place, new rasters are collected in memory up to the size of a pack and the
+ * pack is rewritten on application exit. Keys must be stable across processes.
+ * Gui thread only.
+*/
+class PixelPerfectDiskCache final
+{
+    Q_DISABLE_COPY(PixelPerfectDiskCache)
+
+public:
+    static PixelPerfectDiskCache* instance();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    bool find(quint64 key, QImage* image);
+    void insert(quint64 key, const QImage& image);
+    void flush();
+
+private:
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 count;
+        quint32 reserved;
+    };
+
+    struct Record
+    {
+        quint64 key;
+        quint64 offset;
+        quint32 width;
+        quint32 height;
+        quint32 bytesPerLine;
+        quint32 reserved;
+    };
+
+    PixelPerfectDiskCache();
+
+    static QString filePath();
+    void open();
+    void close();
+    const Record* record(quint64 key) const;
+
+    bool m_enabled;
+    QFile m_file;
+    const uchar* m_data;
+    qint64 m_size;
+    const Record* m_records;
+    quint32 m_count;
+    QHash<quint64, QImage> m_pending;
+    qint64 m_pendingSize; // As laid out in the pack
+    QSet<quint64> m_used;
+};
@@ -0,0 +1,230 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "pixelperfectdistancefield.h"
+
+#include <QtMath>
+
+static constexpr double infinity = 1e20;
+static constexpr int colorTolerance = 24;
+static constexpr int minAlpha = 32;
+
+// Squared distances along one line, Felzenszwalb and Huttenlocher
+static void transformLine(double* line,
+                          int count,
+                          int stride,
+                          QList<double>& values,
+                          QList<int>& parabolas)
+{
+    values.resize(count * 2 + 1);
+    parabolas.resize(count);
+    double* f = values.data();
+    double* z = f + count;
+    int* v = parabolas.data();
+
+    for (int q = 0; q < count; ++q)
+        f[q] = line[q * stride];
+
+    int k = 0;
+    v[0] = 0;
+    z[0] = -infinity;
+    z[1] = infinity;
+    for (int q = 1; q < count; ++q) {
+        double s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = infinity;
+    }
+
+    k = 0;
+    for (int q = 0; q < count; ++q) {
+        while (z[k + 1] < q)
+            ++k;
+        line[q * stride] = (q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+// Zeros mark the pixels distances are measured to
+static void transform(QList<double>& grid, int width, int height)
+{
+    QList<double> values;
+    QList<int> parabolas;
+    for (int x = 0; x < width; ++x)
+        transformLine(grid.data() + x, height, width, values, parabolas);
+    for (int y = 0; y < height; ++y)
+        transformLine(grid.data() + y * width, width, 1, values, parabolas);
+}
+
+PixelPerfectDistanceField::PixelPerfectDistanceField()
+    : m_color(0)
+{}
+
+PixelPerfectDistanceField PixelPerfectDistanceField::fromImage(const QImage& source,
+                                                               int factor)
+{
+    PixelPerfectDistanceField field;
+    const QImage& image = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const int width = image.width();
+    const int height = image.height();
+    if (factor < 1 || width < factor || height < factor)
+        return field;
+
+    // The most opaque pixel gives the color the others are compared with
+    QRgb reference = 0;
+    for (int y = 0; y < height; ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            if (qAlpha(line[x]) > qAlpha(reference))
+                reference = line[x];
+        }
+    }
+    const int opaque = qAlpha(reference);
+    const QRgb color = qUnpremultiply(reference);
+    if (opaque < 128)
+        return field;
+
+    qsizetype covered = 0;
+    qsizetype translucent = 0;
+    for (int y = 0; y < height; ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            if (qAlpha(line[x]) < minAlpha)
+                continue;
+            ++covered;
+            if (qAlpha(line[x]) < opaque - minAlpha)
+                ++translucent;
+
+            const QRgb c = qUnpremultiply(line[x]);
+            if (qAbs(qRed(c) - qRed(color)) > colorTolerance
+                || qAbs(qGreen(c) - qGreen(color)) > colorTolerance
+                || qAbs(qBlue(c) - qBlue(color)) > colorTolerance) {
+                return field;
+            }
+        }
+    }
+
+    // Antialiased edges are a thin band, anything larger is a second color
+    if (translucent * 4 > covered)
+        return field;
+
+    QList<double> inside(qsizetype(width) * height);
+    QList<double> outside(qsizetype(width) * height);
+    for (int y = 0; y < height; ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const bool in = qAlpha(line[x]) * 2 >= opaque;
+            inside[y * width + x] = in ? 0 : infinity;
+            outside[y * width + x] = in ? infinity : 0;
+        }
+    }
+    transform(inside, width, height);
+    transform(outside, width, height);
+
+    // Edges lie half way between the pixels on either side
+    field.m_size = QSize(width / factor, height / factor);
+    field.m_color = qRgba(qRed(color), qGreen(color), qBlue(color), opaque);
+    field.m_distances.resize(qsizetype(field.m_size.width()) * field.m_size.height());
+    for (int fy = 0; fy < field.m_size.height(); ++fy) {
+        for (int fx = 0; fx < field.m_size.width(); ++fx) {
+            double sum = 0;
+            for (int y = fy * factor; y < (fy + 1) * factor; ++y) {
+                for (int x = fx * factor; x < (fx + 1) * factor; ++x) {
+                    const qsizetype i = qsizetype(y) * width + x;
+                    sum += outside[i] > 0 ? qSqrt(outside[i]) - 0.5
+                                          : 0.5 - qSqrt(inside[i]);
+                }
+            }
+            const double distance = sum / (factor * factor) / factor * 256;
+            field.m_distances[fy * field.m_size.width() + fx] = qint16(
+                qBound(-32767.0, distance, 32767.0));
+        }
+    }
+    return field;
+}
+
+bool PixelPerfectDistanceField::isNull() const
+{
+    return m_distances.isEmpty();
+}
+
+QSize PixelPerfectDistanceField::size() const
+{
+    return m_size;
+}
+
+QRgb PixelPerfectDistanceField::color() const
+{
+    return m_color;
+}
+
+qsizetype PixelPerfectDistanceField::cost() const
+{
+    return qMax<qsizetype>(1, m_distances.size() * sizeof(qint16) / 1024);
+}
+
+// Samples the field bilinearly for every pixel and turns the distance into
+// coverage, one pixel wide around the edge
+QImage PixelPerfectDistanceField::render(const QSize& size, QRgb color) const
+{
+    if (isNull() || size.isEmpty())
+        return QImage();
+
+    struct Sample
+    {
+        int first;
+        int second;
+        int weight; // Of the second, out of 256
+    };
+
+    const auto samples = [](int count, int fieldCount) {
+        const qreal ratio = qreal(fieldCount) / count;
+        QList<Sample> samples(count);
+        for (int i = 0; i < count; ++i) {
+            const qreal f = qBound(0.0, (i + 0.5) * ratio - 0.5, fieldCount - 1.0);
+            samples[i] = Sample{.first = int(f),
+                                .second = qMin(int(f) + 1, fieldCount - 1),
+                                .weight = qRound((f - int(f)) * 256)};
+        }
+        return samples;
+    };
+
+    const int width = m_size.width();
+    const QList<Sample>& columns = samples(size.width(), width);
+    const QList<Sample>& rows = samples(size.height(), m_size.height());
+    const qreal fieldPixels = (qreal(width) / size.width()
+                               + qreal(m_size.height()) / size.height())
+                              / 2;
+    const qreal toCoverage = 255 / (256 * fieldPixels);
+
+    QRgb colors[256];
+    for (int a = 0; a < 256; ++a) {
+        const int alpha = (qAlpha(color) * a + 127) / 255;
+        colors[a] = qPremultiply(
+            qRgba(qRed(color), qGreen(color), qBlue(color), alpha));
+    }
+
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < size.height(); ++y) {
+        const Sample& row = rows[y];
+        const qint16* first = m_distances.constData() + row.first * width;
+        const qint16* second = m_distances.constData() + row.second * width;
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const Sample& column = columns[x];
+            const int top = (first[column.first] * (256 - column.weight)
+                             + first[column.second] * column.weight)
+                            >> 8;
+            const int bottom = (second[column.first] * (256 - column.weight)
+                                + second[column.second] * column.weight)
+                               >> 8;
+            const int distance = (top * (256 - row.weight) + bottom * row.weight) >> 8;
+            line[x] = colors[qBound(0, int(distance * toCoverage + 128), 255)];
+        }
+    }
+    return image;
+}
@@ -0,0 +1,34 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QImage>
+#include <QList>
+
+/*
+ * Signed distance field of a single color icon, built once from a large raster
+ * and rendered at any size and color from then on. Distances are stored in
+ * 1/256 of a field pixel and are positive inside the shape. Icons with more
+ * than one color or with translucent areas give a null field.
+*/
+class PixelPerfectDistanceField final
+{
+public:
+    PixelPerfectDistanceField();
+
+    // The image must be factor times larger than the field in both directions
+    static PixelPerfectDistanceField fromImage(const QImage& image, int factor);
+
+    bool isNull() const;
+    QSize size() const;
+    QRgb color() const;
+    qsizetype cost() const; // In kilobytes
+
+    QImage render(const QSize& size, QRgb color) const;
+
+private:
+    QSize m_size;
+    QRgb m_color;
+    QList<qint16> m_distances;
+};
@@ -0,0 +1,292 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "pixelperfecticonatlas.h"
+
+#include <QPainter>
+
+static constexpr int pageSize = 1024;
+static constexpr int pageCost = pageSize * pageSize * 4 / 1024; // In kilobytes
+static constexpr int maxIconSize = 256;
+static constexpr int padding = 1; // Keeps smooth transforms from bleeding
+
+PixelPerfectIconAtlas::PixelPerfectIconAtlas()
+    : m_oversized(32 * 1024) // In kilobytes
+    , m_clock(0)
+    , m_evictions(0)
+    , m_budget(64 * 1024)
+    , m_maxPageCount(8)
+{}
+
+PixelPerfectIconAtlas* PixelPerfectIconAtlas::instance()
+{
+    static PixelPerfectIconAtlas self;
+    return &self;
+}
+
+bool PixelPerfectIconAtlas::find(const PixelPerfectPixmapKey& key,
+                                 PixelPerfectIconAtlasSlot* slot)
+{
+    auto it = m_locations.constFind(key);
+    if (it != m_locations.cend()) {
+        Page& page = m_pages[it->page];
+        page.lastUsed = ++m_clock;
+        *slot = PixelPerfectIconAtlasSlot{.pixmap = &page.pixmap,
+                                          .rect = it->rect,
+                                          .devicePixelRatio = key.devicePixelRatio
+                                                              / 1000.0};
+        return true;
+    }
+
+    if (const QPixmap* pixmap = m_oversized.object(key)) {
+        *slot = PixelPerfectIconAtlasSlot{.pixmap = pixmap,
+                                          .rect = pixmap->rect(),
+                                          .devicePixelRatio
+                                          = pixmap->devicePixelRatio()};
+        return true;
+    }
+
+    return false;
+}
+
+// Same file, mode and state with the closest logical size, any pixel ratio
+bool PixelPerfectIconAtlas::findNearest(const PixelPerfectPixmapKey& key,
+                                        PixelPerfectIconAtlasSlot* slot)
+{
+    const qreal width = key.width * 1000.0 / key.devicePixelRatio;
+    const PixelPerfectPixmapKey* nearest = nullptr;
+    qreal nearestDistance = 0;
+    for (auto it = m_locations.cbegin(); it != m_locations.cend(); ++it) {
+        const PixelPerfectPixmapKey& candidate = it.key();
+        if (candidate.fileId != key.fileId || candidate.mode != key.mode
+            || candidate.state != key.state || candidate.tint != key.tint
+            || candidate.highlight != key.highlight) {
+            continue;
+        }
+        const qreal distance = qAbs(candidate.width * 1000.0
+                                        / candidate.devicePixelRatio
+                                    - width);
+        if (!nearest || distance < nearestDistance) {
+            nearest = &candidate;
+            nearestDistance = distance;
+        }
+    }
+    return nearest && find(*nearest, slot);
+}
+
+PixelPerfectIconAtlasSlot PixelPerfectIconAtlas::insert(
+    const PixelPerfectPixmapKey& key, const QImage& image)
+{
+    if (image.width() > maxIconSize || image.height() > maxIconSize || !m_maxPageCount)
+        return insertOversized(key, QPixmap::fromImage(image));
+    return insertPaged(key, image);
+}
+
+PixelPerfectIconAtlasSlot PixelPerfectIconAtlas::insert(
+    const PixelPerfectPixmapKey& key, QImage&& image)
+{
+    if (image.width() > maxIconSize || image.height() > maxIconSize || !m_maxPageCount)
+        return insertOversized(key, QPixmap::fromImage(std::move(image)));
+    return insertPaged(key, image);
+}
+
+PixelPerfectIconAtlasSlot PixelPerfectIconAtlas::insertOversized(
+    const PixelPerfectPixmapKey& key, QPixmap pixmap)
+{
+    pixmap.setDevicePixelRatio(key.devicePixelRatio / 1000.0);
+    const qsizetype cost = qsizetype(pixmap.width()) * pixmap.height() * pixmap.depth()
+                           / 8 / 1024;
+    const qsizetype size = m_oversized.size() + !m_oversized.contains(key);
+    QPixmap* cached = new QPixmap(pixmap);
+    // Pixmaps costing more than the whole budget are deleted right away
+    if (!m_oversized.insert(key, cached, qMax<qsizetype>(1, cost))) {
+        m_uncached = std::move(pixmap);
+        cached = &m_uncached;
+    }
+    m_evictions += size - m_oversized.size();
+    return PixelPerfectIconAtlasSlot{.pixmap = cached,
+                                     .rect = cached->rect(),
+                                     .devicePixelRatio = cached->devicePixelRatio()};
+}
+
+// Drawn straight into the page, no pixmap is made for the raster on its own. Keys
+// stored already, e.g. by a raster finishing after a synchronous one, keep their
+// slot
+PixelPerfectIconAtlasSlot PixelPerfectIconAtlas::insertPaged(
+    const PixelPerfectPixmapKey& key, const QImage& image)
+{
+    if (auto it = m_locations.constFind(key); it != m_locations.cend()) {
+        Page& page = m_pages[it->page];
+        if (it->rect.size() == image.size()) {
+            page.lastUsed = ++m_clock;
+            return PixelPerfectIconAtlasSlot{.pixmap = &page.pixmap,
+                                             .rect = it->rect,
+                                             .devicePixelRatio = key.devicePixelRatio
+                                                                 / 1000.0};
+        }
+        page.keys.removeOne(key);
+        m_locations.erase(it);
+    }
+
+    QRect rect;
+    const int index = acquirePage(key.devicePixelRatio, image.size(), &rect);
+    Page& page = m_pages[index];
+    page.lastUsed = ++m_clock;
+    page.keys.append(key);
+    m_locations.insert(key, Location{.page = index, .rect = rect});
+
+    QPainter painter(&page.pixmap);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(rect, image, image.rect());
+    painter.end();
+
+    return PixelPerfectIconAtlasSlot{.pixmap = &page.pixmap,
+                                     .rect = rect,
+                                     .devicePixelRatio = key.devicePixelRatio
+                                                         / 1000.0};
+}
+
+// The space of removed rasters is reused once their page is recycled
+void PixelPerfectIconAtlas::removeIf(
+    const std::function<bool(const PixelPerfectPixmapKey&)>& predicate)
+{
+    for (Page& page : m_pages) {
+        page.keys.removeIf([&](const PixelPerfectPixmapKey& key) {
+            return predicate(key) && m_locations.remove(key);
+        });
+    }
+    const QList<PixelPerfectPixmapKey>& oversizedKeys = m_oversized.keys();
+    for (const PixelPerfectPixmapKey& key : oversizedKeys) {
+        if (predicate(key))
+            m_oversized.remove(key);
+    }
+}
+
+void PixelPerfectIconAtlas::clear()
+{
+    m_pages.clear();
+    m_locations.clear();
+    m_oversized.clear();
+    m_uncached = QPixmap();
+}
+
+int PixelPerfectIconAtlas::budget() const
+{
+    return m_budget;
+}
+
+// Half of the budget goes to pages, the rest to icons too large for them. Budgets
+// too small for two pages have none, every icon is then kept on its own
+void PixelPerfectIconAtlas::setBudget(int kilobytes)
+{
+    m_budget = qMax(0, kilobytes);
+    m_maxPageCount = m_budget / 2 / pageCost;
+    trimPages();
+
+    const qsizetype size = m_oversized.size();
+    m_oversized.setMaxCost(qMax(0, m_budget - m_maxPageCount * pageCost));
+    m_evictions += size - m_oversized.size();
+}
+
+qint64 PixelPerfectIconAtlas::evictions() const
+{
+    return m_evictions;
+}
+
+qsizetype PixelPerfectIconAtlas::cost() const
+{
+    return m_pages.size() * pageCost + m_oversized.totalCost();
+}
+
+qsizetype PixelPerfectIconAtlas::count() const
+{
+    return m_locations.size() + m_oversized.size();
+}
+
+void PixelPerfectIconAtlas::resetEvictions()
+{
+    m_evictions = 0;
+}
+
+bool PixelPerfectIconAtlas::allocate(Page& page, const QSize& size, QRect* rect)
+{
+    const int w = size.width() + padding;
+    const int h = size.height() + padding;
+
+    // Best fitting shelf first, tall shelves waste the space above short icons
+    Shelf* best = nullptr;
+    for (Shelf& shelf : page.shelves) {
+        if (shelf.height >= h && pageSize - shelf.width >= w
+            && (!best || shelf.height < best->height)) {
+            best = &shelf;
+        }
+    }
+
+    if (!best) {
+        const int y = page.shelves.isEmpty()
+                          ? 0
+                          : page.shelves.last().y + page.shelves.last().height;
+        if (pageSize - y < h || pageSize < w)
+            return false;
+        page.shelves.append(Shelf{.y = y, .height = h, .width = 0});
+        best = &page.shelves.last();
+    }
+
+    *rect = QRect(QPoint(best->width, best->y), size);
+    best->width += w;
+    return true;
+}
+
+int PixelPerfectIconAtlas::acquirePage(quint16 devicePixelRatio,
+                                       const QSize& size,
+                                       QRect* rect)
+{
+    for (int i = 0; i < m_pages.size(); ++i) {
+        if (m_pages[i].devicePixelRatio == devicePixelRatio
+            && allocate(m_pages[i], size, rect)) {
+            return i;
+        }
+    }
+
+    int index = m_pages.size();
+    if (index < m_maxPageCount) {
+        QPixmap pixmap(pageSize, pageSize);
+        pixmap.fill(Qt::transparent);
+        m_pages.append(Page{.pixmap = pixmap,
+                            .devicePixelRatio = devicePixelRatio,
+                            .lastUsed = 0,
+                            .shelves = {},
+                            .keys = {}});
+    } else {
+        index = 0;
+        for (int i = 1; i < m_pages.size(); ++i) {
+            if (m_pages[i].lastUsed < m_pages[index].lastUsed)
+                index = i;
+        }
+        recycle(index);
+        m_pages[index].devicePixelRatio = devicePixelRatio;
+    }
+
+    allocate(m_pages[index], size, rect);
+    return index;
+}
+
+void PixelPerfectIconAtlas::recycle(int index)
+{
+    Page& page = m_pages[index];
+    m_evictions += page.keys.size();
+    for (const PixelPerfectPixmapKey& key : std::as_const(page.keys))
+        m_locations.remove(key);
+    page.keys.clear();
+    page.shelves.clear();
+    page.pixmap.fill(Qt::transparent);
+}
+
+// Pages are dropped from the back, so the locations of the others stay valid
+void PixelPerfectIconAtlas::trimPages()
+{
+    while (m_pages.size() > m_maxPageCount) {
+        recycle(m_pages.size() - 1);
+        m_pages.removeLast();
+    }
+}
@@ -0,0 +1,97 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include "pixelperfecticonengine.h"
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPixmap>
+
+#include <functional>
+
+// A sub-rect of an atlas page, or the whole of a pixmap too large for the
+// atlas. The pointer stays valid until the next insertion into the atlas.
+struct PixelPerfectIconAtlasSlot
+{
+    const QPixmap* pixmap;
+    QRect rect;
+    qreal devicePixelRatio;
+};
+
+/*
+ * Packs rasterized icons of the same device pixel ratio into shared pages with
+ * a shelf packer, so that icons drawn next to each other come from the same
+ * backing pixmap. When the page budget is spent, the least recently used page
+ * is emptied and reused.
+*/
+class PixelPerfectIconAtlas final
+{
+    Q_DISABLE_COPY(PixelPerfectIconAtlas)
+
+public:
+    static PixelPerfectIconAtlas* instance();
+
+    bool find(const PixelPerfectPixmapKey& key, PixelPerfectIconAtlasSlot* slot);
+    bool findNearest(const PixelPerfectPixmapKey& key, PixelPerfectIconAtlasSlot* slot);
+    // Rasters are premultiplied images at the pixel ratio of the key, moved
+    // ones are turned into oversized pixmaps without a copy
+    PixelPerfectIconAtlasSlot insert(const PixelPerfectPixmapKey& key,
+                                     const QImage& image);
+    PixelPerfectIconAtlasSlot insert(const PixelPerfectPixmapKey& key, QImage&& image);
+    void removeIf(const std::function<bool(const PixelPerfectPixmapKey&)>& predicate);
+    void clear();
+
+    int budget() const;
+    void setBudget(int kilobytes);
+    qint64 evictions() const;
+    qsizetype cost() const;
+    qsizetype count() const;
+    void resetEvictions();
+
+private:
+    struct Shelf
+    {
+        int y;
+        int height;
+        int width;
+    };
+
+    struct Page
+    {
+        QPixmap pixmap;
+        quint16 devicePixelRatio;
+        quint64 lastUsed;
+        QList<Shelf> shelves;
+        QList<PixelPerfectPixmapKey> keys;
+    };
+
+    struct Location
+    {
+        int page;
+        QRect rect;
+    };
+
+    PixelPerfectIconAtlas();
+
+    static bool allocate(Page& page, const QSize& size, QRect* rect);
+    int acquirePage(quint16 devicePixelRatio, const QSize& size, QRect* rect);
+    void recycle(int page);
+    void trimPages();
+    PixelPerfectIconAtlasSlot insertOversized(const PixelPerfectPixmapKey& key,
+                                              QPixmap pixmap);
+    PixelPerfectIconAtlasSlot insertPaged(const PixelPerfectPixmapKey& key,
+                                          const QImage& image);
+
+    QList<Page> m_pages;
+    QHash<PixelPerfectPixmapKey, Location> m_locations;
+    QCache<PixelPerfectPixmapKey, QPixmap> m_oversized;
+    QPixmap m_uncached;
+    quint64 m_clock;
+    qint64 m_evictions;
+    int m_budget;
+    int m_maxPageCount;
+};
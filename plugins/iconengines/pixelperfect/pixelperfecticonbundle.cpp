@@ -0,0 +1,262 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "pixelperfecticonbundle.h"
+
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+
+#include <algorithm>
+
+using namespace Qt::Literals;
+
+static constexpr quint32 bundleMagic = 0x41574942; // AWIB
+static constexpr quint32 bundleVersion = 1;
+static constexpr qint64 dataAlignment = 16;
+
+static qint64 aligned(qint64 offset)
+{
+    return (offset + dataAlignment - 1) & ~(dataAlignment - 1);
+}
+
+PixelPerfectIconBundle::PixelPerfectIconBundle(const QString& filePath)
+    : m_file(filePath)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_records(nullptr)
+    , m_count(0)
+{
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(Header)))
+        return;
+
+    const uchar* data = m_file.map(0, m_file.size());
+    if (!data)
+        return;
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    const qint64 indexSize = qint64(sizeof(Header)) + header->count * sizeof(Record);
+    if (header->magic != bundleMagic || header->version != bundleVersion
+        || indexSize > m_file.size()) {
+        m_file.unmap(const_cast<uchar*>(data));
+        return;
+    }
+
+    // Offsets and sizes are compared one by one, sums of corrupt fields could
+    // wrap around. Lookups rely on the records being sorted by name
+    const quint64 size = quint64(m_file.size());
+    const auto fits = [size](quint64 offset, quint64 length) {
+        return offset <= size && length <= size - offset;
+    };
+    const Record* records = reinterpret_cast<const Record*>(data + sizeof(Header));
+    for (quint32 i = 0; i < header->count; ++i) {
+        const Record& r = records[i];
+        const quint64 rasterSize = quint64(r.rasterBytesPerLine) * r.height;
+        if (!fits(r.nameOffset, r.nameSize) || !fits(r.dataOffset, r.dataSize)
+            || (r.rasterOffset
+                && (r.rasterOffset % dataAlignment != 0
+                    || r.rasterBytesPerLine < quint64(r.width) * 4
+                    || !fits(r.rasterOffset, rasterSize)))
+            || (i > 0
+                && QByteArrayView(data + records[i - 1].nameOffset,
+                                  records[i - 1].nameSize)
+                       >= QByteArrayView(data + r.nameOffset, r.nameSize))) {
+            m_file.unmap(const_cast<uchar*>(data));
+            return;
+        }
+    }
+
+    m_data = data;
+    m_size = m_file.size();
+    m_records = records;
+    m_count = header->count;
+}
+
+PixelPerfectIconBundle::~PixelPerfectIconBundle()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+}
+
+bool PixelPerfectIconBundle::isValid() const
+{
+    return m_data;
+}
+
+QString PixelPerfectIconBundle::filePath() const
+{
+    return m_file.fileName();
+}
+
+QStringList PixelPerfectIconBundle::fileNames() const
+{
+    QStringList fileNames;
+    fileNames.reserve(m_count);
+    for (quint32 i = 0; i < m_count; ++i)
+        fileNames.append(QString::fromUtf8(name(m_records[i])));
+    return fileNames;
+}
+
+int PixelPerfectIconBundle::indexOf(const QString& fileName) const
+{
+    const QByteArray& utf8 = fileName.toUtf8();
+    const Record* end = m_records + m_count;
+    const Record* r = std::lower_bound(m_records,
+                                       end,
+                                       QByteArrayView(utf8),
+                                       [this](const Record& r, QByteArrayView name) {
+                                           return this->name(r) < name;
+                                       });
+    if (r == end || name(*r) != utf8)
+        return -1;
+    return int(r - m_records);
+}
+
+QSize PixelPerfectIconBundle::size(int index) const
+{
+    const Record& r = m_records[index];
+    return QSize(r.width, r.height);
+}
+
+// Refers to the mapped file, valid as long as the bundle is
+QByteArray PixelPerfectIconBundle::data(int index) const
+{
+    const Record& r = m_records[index];
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + r.dataOffset),
+                                   qsizetype(r.dataSize));
+}
+
+// Refers to the mapped file and keeps the bundle alive while doing so
+QImage PixelPerfectIconBundle::raster(int index) const
+{
+    const Record& r = m_records[index];
+    if (!r.rasterOffset)
+        return QImage();
+
+    return QImage(
+        m_data + r.rasterOffset,
+        r.width,
+        r.height,
+        r.rasterBytesPerLine,
+        QImage::Format_ARGB32_Premultiplied,
+        [](void* bundle) {
+            delete static_cast<QSharedPointer<const PixelPerfectIconBundle>*>(bundle);
+        },
+        new QSharedPointer<const PixelPerfectIconBundle>(sharedFromThis()));
+}
+
+QByteArrayView PixelPerfectIconBundle::name(const Record& record) const
+{
+    return QByteArrayView(m_data + record.nameOffset, record.nameSize);
+}
+
+bool PixelPerfectIconBundle::write(const QString& filePath,
+                                   const QStringList& sourceFilePaths,
+                                   bool rasterize,
+                                   QString* errorString)
+{
+    struct Item
+    {
+        QByteArray name;
+        QByteArray data;
+        QImage raster;
+        QSize size;
+    };
+
+    const auto fail = [errorString](const QString& error) {
+        if (errorString)
+            *errorString = error;
+        return false;
+    };
+
+    QList<Item> items;
+    for (const QString& sourceFilePath : sourceFilePaths) {
+        QFile source(sourceFilePath);
+        if (!source.open(QIODevice::ReadOnly)) {
+            return fail(
+                u"Cannot read %1: %2"_s.arg(sourceFilePath, source.errorString()));
+        }
+
+        QImageReader reader(sourceFilePath);
+        Item item{.name = QFileInfo(sourceFilePath).fileName().toUtf8(),
+                  .data = source.readAll(),
+                  .raster = QImage(),
+                  .size = reader.size()};
+        if (!item.size.isValid())
+            return fail(u"Not an image: %1"_s.arg(sourceFilePath));
+        if (rasterize) {
+            item.raster = reader.read().convertToFormat(
+                QImage::Format_ARGB32_Premultiplied);
+        }
+        items.append(item);
+    }
+
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return a.name < b.name;
+    });
+    for (qsizetype i = 1; i < items.size(); ++i) {
+        if (items.at(i - 1).name == items.at(i).name) {
+            return fail(u"Duplicate file name: %1"_s.arg(
+                QString::fromUtf8(items.at(i).name)));
+        }
+    }
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(u"Cannot write %1: %2"_s.arg(filePath, file.errorString()));
+
+    const Header header{.magic = bundleMagic,
+                        .version = bundleVersion,
+                        .count = quint32(items.size()),
+                        .reserved = 0};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Names first, then the contents, then the rasters
+    qint64 offset = sizeof(Header) + items.size() * sizeof(Record);
+    QList<Record> records;
+    for (const Item& item : std::as_const(items)) {
+        records.append(Record{.nameOffset = quint32(offset),
+                              .nameSize = quint32(item.name.size()),
+                              .width = quint32(item.size.width()),
+                              .height = quint32(item.size.height()),
+                              .dataOffset = 0,
+                              .dataSize = quint64(item.data.size()),
+                              .rasterOffset = 0,
+                              .rasterBytesPerLine = 0,
+                              .reserved = 0});
+        offset += item.name.size();
+    }
+    for (Record& r : records) {
+        r.dataOffset = quint64(offset);
+        offset += qint64(r.dataSize);
+    }
+    for (qsizetype i = 0; i < items.size(); ++i) {
+        const QImage& raster = items.at(i).raster;
+        if (raster.isNull())
+            continue;
+        offset = aligned(offset);
+        records[i].rasterOffset = quint64(offset);
+        records[i].rasterBytesPerLine = quint32(raster.bytesPerLine());
+        offset += raster.sizeInBytes();
+    }
+
+    file.write(reinterpret_cast<const char*>(records.constData()),
+               records.size() * sizeof(Record));
+    for (const Item& item : std::as_const(items))
+        file.write(item.name);
+    for (const Item& item : std::as_const(items))
+        file.write(item.data);
+
+    static const QByteArray padding(dataAlignment, '\0');
+    for (const Item& item : std::as_const(items)) {
+        if (item.raster.isNull())
+            continue;
+        file.write(padding.constData(), aligned(file.pos()) - file.pos());
+        file.write(reinterpret_cast<const char*>(item.raster.constBits()),
+                   item.raster.sizeInBytes());
+    }
+
+    if (!file.commit())
+        return fail(u"Cannot write %1: %2"_s.arg(filePath, file.errorString()));
+    return true;
+}
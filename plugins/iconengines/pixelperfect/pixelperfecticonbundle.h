@@ -0,0 +1,70 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QEnableSharedFromThis>
+#include <QFile>
+#include <QImage>
+#include <QStringList>
+
+/*
+ * A directory of icon files packed into one file: a header, an index sorted by
+ * file name with the image size of every file, the file names, the file
+ * contents and optionally premultiplied rasters of every file at its own size.
+ * The bundle is mapped and read in place. Icons inside are addressed as if the
+ * bundle was a directory, e.g. icons.awib/edit.svg, and variants follow the
+ * same naming as on disk. Read only once opened, safe to share across threads.
+*/
+class PixelPerfectIconBundle final
+    : public QEnableSharedFromThis<PixelPerfectIconBundle>
+{
+    Q_DISABLE_COPY(PixelPerfectIconBundle)
+
+public:
+    explicit PixelPerfectIconBundle(const QString& filePath);
+    ~PixelPerfectIconBundle();
+
+    bool isValid() const;
+    QString filePath() const;
+    QStringList fileNames() const;
+    int indexOf(const QString& fileName) const;
+    QSize size(int index) const;
+    QByteArray data(int index) const;
+    QImage raster(int index) const;
+
+    static bool write(const QString& filePath,
+                      const QStringList& sourceFilePaths,
+                      bool rasterize,
+                      QString* errorString = nullptr);
+
+private:
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 count;
+        quint32 reserved;
+    };
+
+    struct Record
+    {
+        quint32 nameOffset;
+        quint32 nameSize;
+        quint32 width;
+        quint32 height;
+        quint64 dataOffset;
+        quint64 dataSize;
+        quint64 rasterOffset; // Zero when not rasterized
+        quint32 rasterBytesPerLine;
+        quint32 reserved;
+    };
+
+    QByteArrayView name(const Record& record) const;
+
+    QFile m_file;
+    const uchar* m_data;
+    qint64 m_size;
+    const Record* m_records;
+    quint32 m_count;
+};
@@ -2,55 +2,938 @@
 // SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
 
 #include "pixelperfecticonengine.h"
+#include "pixelperfecticonatlas.h"
+#include "pixelperfecticonbundle.h"
+#include "pixelperfectdiskcache.h"
+#include "pixelperfectdistancefield.h"
+#include "pixelperfectkernels.h"
 
-#include <private/qhexstring_p.h>
-#include <private/qguiapplication_p.h>
-
+#include <QBuffer>
+#include <QCache>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QGuiApplication>
+#include <QHash>
 #include <QImageReader>
+#include <QMutex>
 #include <QPainter>
-#include <QPixmapCache>
+#include <QPalette>
+#include <QPointer>
+#include <QSet>
 #include <QStyleHints>
+#include <QSvgRenderer>
+#include <QThread>
+#include <QThreadPool>
+#include <QtEndian>
+
+#include <algorithm>
+#include <atomic>
 
-// TODO: Implement data stream functions
 // TODO: Implement addPixmap function and all the rest functionality to
 // simulate the original QPixmapIconEngine behavior as a fallback mechanism
 
 using namespace Qt::Literals;
 
+// Variant file names of a directory keyed by the plain file name they belong
+// to, e.g. icon.dark.200.svg is listed under icon.svg. Resolved variants keep
+// their entries alive, so constructing the same icon again is a hash lookup
+struct PixelPerfectIconEngineDirectory
+{
+    QHash<QString, QMap<int, QString>> filePaths;
+    QHash<QString, QMap<int, QString>> filePathsDark;
+    QHash<QString, PixelPerfectIconEngineVariants> variants;
+    QSharedPointer<PixelPerfectIconBundle> bundle; // When the directory is one
+};
+
+struct PixelPerfectIconEngineRegistry
+{
+    QMutex mutex;
+    QHash<QString, QWeakPointer<PixelPerfectIconEngineEntry>> entries;
+    QHash<QString, PixelPerfectIconEngineDirectory> directories;
+    QHash<QString, QSharedPointer<PixelPerfectIconBundle>> bundles;
+    QSet<PixelPerfectIconEngine*> engines;
+    QPointer<QFileSystemWatcher> watcher;
+    bool colorSchemeSubscribed = false;
+};
+
+static PixelPerfectIconEngineRegistry& registry()
+{
+    static PixelPerfectIconEngineRegistry registry;
+    return registry;
+}
+
+// Pixmaps are only ever touched from the gui thread, no locking needed
+static QCache<PixelPerfectPixmapKey, QPixmap>& pixmapCache()
+{
+    static QCache<PixelPerfectPixmapKey, QPixmap> cache(64 * 1024); // In kilobytes
+    return cache;
+}
+
+// Hits and misses of both pixmap stores, evictions of the pixmap cache only
+static PixelPerfectIconEngineCacheStatistics pixmapStatistics{.hits = 0,
+                                                              .misses = 0,
+                                                              .evictions = 0,
+                                                              .cost = 0,
+                                                              .count = 0};
+
+static bool findPixmap(const PixelPerfectPixmapKey& key, QPixmap* pixmap)
+{
+    if (const QPixmap* cached = pixmapCache().object(key)) {
+        *pixmap = *cached;
+        ++pixmapStatistics.hits;
+        return true;
+    }
+    ++pixmapStatistics.misses;
+    return false;
+}
+
+static void insertPixmap(const PixelPerfectPixmapKey& key, const QPixmap& pixmap)
+{
+    const qsizetype cost = qsizetype(pixmap.width()) * pixmap.height() * pixmap.depth()
+                           / 8 / 1024;
+    const qsizetype size = pixmapCache().size() + !pixmapCache().contains(key);
+    pixmapCache().insert(key, new QPixmap(pixmap), qMax<qsizetype>(1, cost));
+    pixmapStatistics.evictions += size - pixmapCache().size();
+}
+
+static bool asynchronous = false;
+static bool distanceFieldEnabled = false;
+
+struct PixelPerfectPendingRaster
+{
+    QList<QPointer<QObject>> updateTargets;
+    QList<std::function<void()>> callbacks;
+};
+
+static QHash<PixelPerfectPixmapKey, PixelPerfectPendingRaster>& pendingRasters()
+{
+    static QHash<PixelPerfectPixmapKey, PixelPerfectPendingRaster> pending;
+    return pending;
+}
+
+// Keys of rasters that came out null, so unreadable files are not read again on
+// every paint. File ids change along with the files, stale keys never match
+static QSet<PixelPerfectPixmapKey>& nullRasters()
+{
+    static QSet<PixelPerfectPixmapKey> keys;
+    return keys;
+}
+
+static QThreadPool& rasterThreadPool()
+{
+    static QThreadPool pool;
+    static const bool initialized = [] {
+        pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+        // Results must not be posted to a destroyed application
+        qAddPostRoutine([] {
+            pool.clear();
+            pool.waitForDone();
+        });
+        return true;
+    }();
+    Q_UNUSED(initialized)
+    return pool;
+}
+
+struct PixelPerfectMipChains
+{
+    QMutex mutex;
+    QCache<quint64, QList<QImage>> chains{16 * 1024}; // In kilobytes
+};
+
+static PixelPerfectMipChains& mipChains()
+{
+    static PixelPerfectMipChains mipChains;
+    return mipChains;
+}
+
+// Halved levels of a raster variant down to a single pixel, keyed by file id
+static QList<QImage> mipChain(quint64 fileId, QImageReader* reader)
+{
+    PixelPerfectMipChains& m = mipChains();
+    {
+        QMutexLocker locker(&m.mutex);
+        if (const QList<QImage>* chain = m.chains.object(fileId))
+            return *chain;
+    }
+
+    QList<QImage> chain{reader->read().convertToFormat(
+        QImage::Format_ARGB32_Premultiplied)};
+    if (chain.first().isNull())
+        return {};
+    while (chain.last().width() > 1 || chain.last().height() > 1)
+        chain.append(PixelPerfectKernels::halve(chain.last()));
+
+    qsizetype cost = 0;
+    for (const QImage& level : std::as_const(chain))
+        cost += level.sizeInBytes() / 1024;
+
+    QMutexLocker locker(&m.mutex);
+    m.chains.insert(fileId, new QList<QImage>(chain), qMax<qsizetype>(1, cost));
+    return chain;
+}
+
+// Parsed documents are reused for every size, mode and engine clone. A
+// renderer draws for one thread at a time, hence the lock next to it
+struct PixelPerfectSvgRenderer
+{
+    QMutex mutex;
+    QSvgRenderer renderer;
+};
+
+struct PixelPerfectSvgRenderers
+{
+    QMutex mutex;
+    QCache<quint64, QSharedPointer<PixelPerfectSvgRenderer>> renderers{64};
+};
+
+static PixelPerfectSvgRenderers& svgRenderers()
+{
+    static PixelPerfectSvgRenderers svgRenderers;
+    return svgRenderers;
+}
+
+static QSharedPointer<PixelPerfectSvgRenderer> svgRenderer(
+    const PixelPerfectIconEngineEntry& entry)
+{
+    PixelPerfectSvgRenderers& r = svgRenderers();
+    {
+        QMutexLocker locker(&r.mutex);
+        if (const auto cached = r.renderers.object(entry.fileId))
+            return *cached;
+    }
+
+    QSharedPointer<PixelPerfectSvgRenderer> renderer(new PixelPerfectSvgRenderer);
+    if (!(entry.bundle ? renderer->renderer.load(entry.bundle->data(entry.bundleIndex))
+                       : renderer->renderer.load(entry.filePath))) {
+        return {};
+    }
+    // Whichever thread evicts the renderer deletes it, so it must not belong to
+    // the pool thread loading it. Animation timers stop along with that
+    renderer->renderer.moveToThread(nullptr);
+
+    QMutexLocker locker(&r.mutex);
+    r.renderers.insert(entry.fileId,
+                       new QSharedPointer<PixelPerfectSvgRenderer>(renderer));
+    return renderer;
+}
+
+static bool isSvgFile(const QString& filePath)
+{
+    return filePath.endsWith(".svg"_L1, Qt::CaseInsensitive)
+           || filePath.endsWith(".svgz"_L1, Qt::CaseInsensitive);
+}
+
+// Decoded images are not shared with anything yet, so they convert in place
+static QImage premultiplied(QImage image)
+{
+    image.convertTo(QImage::Format_ARGB32_Premultiplied);
+    return image;
+}
+
+// Reads the file at the given scale, safe to call from any thread
+static QImage rasterize(const PixelPerfectIconEngineEntry& entry, qreal scale)
+{
+    if (entry.bundle && entry.bundleIndex < 0)
+        return QImage();
+
+    const QSize targetSize(qCeil(entry.size.width() * scale),
+                           qCeil(entry.size.height() * scale));
+    if (isSvgFile(entry.filePath)) {
+        const QSharedPointer<PixelPerfectSvgRenderer>& svg = svgRenderer(entry);
+        if (!svg || targetSize.isEmpty())
+            return QImage();
+
+        QImage image(targetSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        QMutexLocker locker(&svg->mutex);
+        svg->renderer.render(&painter, QRectF(QPointF(0, 0), targetSize));
+        return image;
+    }
+
+    QBuffer buffer;
+    QImageReader reader;
+    if (entry.bundle) {
+        if (qFuzzyCompare(scale, 1.0)) {
+            if (const QImage& raster = entry.bundle->raster(entry.bundleIndex);
+                !raster.isNull()) {
+                return raster;
+            }
+        }
+        buffer.setData(entry.bundle->data(entry.bundleIndex));
+        buffer.open(QIODevice::ReadOnly);
+        reader.setDevice(&buffer);
+    } else {
+        reader.setFileName(entry.filePath);
+    }
+
+    if (qFuzzyCompare(scale, 1.0))
+        return premultiplied(reader.read());
+
+    if (reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(targetSize);
+        return premultiplied(reader.read());
+    }
+
+    // Pixel art stays crisp when every pixel just gets repeated
+    const int factor = qRound(scale);
+    if (qFuzzyCompare(scale, qreal(factor)))
+        return PixelPerfectKernels::upscale(reader.read(), factor);
+
+    // Start from the smallest level still covering the target, so the smooth
+    // transform never reduces by more than half and doesn't alias
+    if (scale < 1) {
+        const QList<QImage>& chain = mipChain(entry.fileId, &reader);
+        if (chain.isEmpty())
+            return QImage();
+
+        qsizetype level = 0;
+        while (level + 1 < chain.size()
+               && chain.at(level + 1).width() >= targetSize.width()
+               && chain.at(level + 1).height() >= targetSize.height()) {
+            ++level;
+        }
+        if (chain.at(level).size() == targetSize)
+            return chain.at(level);
+        return chain.at(level).scaled(targetSize,
+                                      Qt::IgnoreAspectRatio,
+                                      Qt::SmoothTransformation);
+    }
+
+    QImage image(targetSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing
+                           | QPainter::SmoothPixmapTransform
+                           | QPainter::LosslessImageRendering);
+    painter.scale(scale, scale);
+    painter.drawImage(QPoint{0, 0}, reader.read());
+    painter.end();
+    return image;
+}
+
+// Share of the highlight color in selected icons, out of 256
+static constexpr int selectedStrength = 77;
+// Opacity of disabled icons, out of 256
+static constexpr int disabledOpacity = 128;
+
+// Selected icons depend on the highlight color of the palette, so keys carry it
+static QRgb highlightFor(QIcon::Mode mode)
+{
+    if (mode != QIcon::Selected)
+        return 0;
+    return QGuiApplication::palette().color(QPalette::Highlight).rgba();
+}
+
+// Rasters of an older highlight color would only take up room. Checked on
+// paint, the palette change event only reaches the application object. Other
+// rasters stay, only selected ones depend on the highlight
+static void dropStaleHighlight(QRgb highlight)
+{
+    static QRgb lastHighlight = 0;
+    if (!highlight || highlight == lastHighlight)
+        return;
+
+    if (lastHighlight) {
+        const auto isStale = [highlight](const PixelPerfectPixmapKey& key) {
+            return key.highlight && key.highlight != highlight;
+        };
+        PixelPerfectIconAtlas::instance()->removeIf(isStale);
+        const QList<PixelPerfectPixmapKey>& keys = pixmapCache().keys();
+        for (const PixelPerfectPixmapKey& key : keys) {
+            if (isStale(key))
+                pixmapCache().remove(key);
+        }
+        nullRasters().removeIf(isStale);
+    }
+    lastHighlight = highlight;
+}
+
+// Turns a normal raster into the given mode and tint, gui thread only. Active
+// icons look the same as normal ones, like QCommonStyle does
+static void generate(QImage* image, QIcon::Mode mode, QRgb tint, QRgb highlight)
+{
+    if (mode == QIcon::Disabled)
+        PixelPerfectKernels::grayscale(image, disabledOpacity);
+    else if (mode == QIcon::Selected)
+        PixelPerfectKernels::highlight(image, highlight, selectedStrength);
+
+    // Generated modes only change the alpha as far as the tint is concerned
+    if (tint)
+        PixelPerfectKernels::colorize(image, tint);
+}
+
+static constexpr int distanceFieldExtent = 64;
+static constexpr int distanceFieldFactor = 4;
+
+// Only touched from the gui thread, null fields remember the icons that turned
+// out to have more than one color
+static QCache<quint64, PixelPerfectDistanceField>& distanceFields()
+{
+    static QCache<quint64, PixelPerfectDistanceField> cache(2 * 1024); // In kilobytes
+    return cache;
+}
+
+// Objects to update once the field of a file id is built
+static QHash<quint64, QList<QPointer<QObject>>>& pendingDistanceFields()
+{
+    static QHash<quint64, QList<QPointer<QObject>>> pending;
+    return pending;
+}
+
+// Vector icons only, raster variants are meant to be drawn as they are. Fields
+// are built on the raster pool, icons are drawn from the atlas until then
+static const PixelPerfectDistanceField* distanceField(
+    const PixelPerfectIconEngineEntry& entry, QObject* updateTarget)
+{
+    if (!isSvgFile(entry.filePath) || entry.size.isEmpty())
+        return nullptr;
+
+    if (const PixelPerfectDistanceField* field = distanceFields().object(entry.fileId))
+        return field->isNull() ? nullptr : field;
+
+    const bool requested = pendingDistanceFields().contains(entry.fileId);
+    QList<QPointer<QObject>>& updateTargets = pendingDistanceFields()[entry.fileId];
+    if (updateTarget && !updateTargets.contains(updateTarget))
+        updateTargets.append(updateTarget);
+    if (requested)
+        return nullptr;
+
+    rasterThreadPool().start([entry] {
+        const qreal scale = qreal(distanceFieldExtent * distanceFieldFactor)
+                            / qMax(entry.size.width(), entry.size.height());
+        const PixelPerfectDistanceField& field
+            = PixelPerfectDistanceField::fromImage(rasterize(entry, scale),
+                                                   distanceFieldFactor);
+        QMetaObject::invokeMethod(
+            qApp,
+            [fileId = entry.fileId, field] {
+                const QList<QPointer<QObject>>& updateTargets
+                    = pendingDistanceFields().take(fileId);
+                if (!distanceFieldEnabled)
+                    return;
+                distanceFields().insert(fileId,
+                                        new PixelPerfectDistanceField(field),
+                                        field.cost());
+                // Icons of more than one color stay as the atlas drew them
+                if (field.isNull())
+                    return;
+                for (const QPointer<QObject>& target : updateTargets) {
+                    if (target)
+                        QMetaObject::invokeMethod(target, "update");
+                }
+            },
+            Qt::QueuedConnection);
+    });
+    return nullptr;
+}
+
+// Centers an icon of the given logical size within the rect, on whole pixels
+static QRectF iconRect(const QRect& rect, const QSizeF& size)
+{
+    QRectF iconRect({0, 0}, size);
+    iconRect.moveCenter(QRectF(rect).center());
+    iconRect.moveTopLeft(QPointF(int(qMax(iconRect.x(), qreal(rect.x()))),
+                                 int(qMax(iconRect.y(), qreal(rect.y())))));
+    return iconRect;
+}
+
+static void requestRaster(const PixelPerfectPixmapKey& key,
+                          quint64 diskKey,
+                          const PixelPerfectIconEngineEntry& entry,
+                          qreal scale,
+                          QIcon::Mode mode,
+                          QObject* updateTarget,
+                          const std::function<void()>& done = {})
+{
+    const bool requested = pendingRasters().contains(key);
+    PixelPerfectPendingRaster& pending = pendingRasters()[key];
+    if (updateTarget && !pending.updateTargets.contains(updateTarget))
+        pending.updateTargets.append(updateTarget);
+    if (done)
+        pending.callbacks.append(done);
+    if (requested)
+        return;
+
+    // The raster is moved along, so generating the mode doesn't detach it
+    rasterThreadPool().start([=] {
+        QMetaObject::invokeMethod(
+            qApp,
+            [=, image = rasterize(entry, scale)]() mutable {
+                const PixelPerfectPendingRaster& pending = pendingRasters().take(key);
+                if (image.isNull()) {
+                    nullRasters().insert(key);
+                } else {
+                    generate(&image, mode, key.tint, key.highlight);
+                    PixelPerfectDiskCache::instance()->insert(diskKey, image);
+                    PixelPerfectIconAtlas::instance()->insert(key, std::move(image));
+                    for (const QPointer<QObject>& target : pending.updateTargets) {
+                        if (target)
+                            QMetaObject::invokeMethod(target, "update");
+                    }
+                }
+                for (const std::function<void()>& callback : pending.callbacks)
+                    callback();
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+static constexpr quint8 streamVersion = 1;
+static constexpr qsizetype maxSelections = 32;
+static constexpr qsizetype maxUsages = 8;
+
+// Bumped for every new or changed file
+static std::atomic<quint64> lastFileId = 0;
+
+// Called with the registry mutex held
+static quint64 nextFileId()
+{
+    return ++lastFileId;
+}
+
+// Called with the registry mutex held. Tells whether the entry changed
+static bool refreshEntry(PixelPerfectIconEngineEntry* entry)
+{
+    // Files of a bundle change along with it
+    const QFileInfo info(entry->bundle ? entry->bundle->filePath() : entry->filePath);
+    const QDateTime& lastModified = info.lastModified(QTimeZone::UTC);
+    if (entry->fileId != 0 && entry->lastModified == lastModified
+        && entry->fileSize == info.size()) {
+        return false;
+    }
+
+    if (!entry->bundle)
+        entry->size = QImageReader(entry->filePath).size();
+    else if (entry->bundleIndex >= 0)
+        entry->size = entry->bundle->size(entry->bundleIndex);
+    else
+        entry->size = QSize();
+    entry->lastModified = lastModified;
+    entry->fileSize = info.size();
+    entry->fileId = nextFileId();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData((entry->bundle ? entry->filePath : info.canonicalFilePath()).toUtf8());
+    hash.addData(QByteArray::number(lastModified.toMSecsSinceEpoch()));
+    hash.addData(QByteArray::number(entry->fileSize));
+    entry->fileHash = qFromLittleEndian<quint64>(hash.resultView().constData());
+    return true;
+}
+
+// The watch of a file goes with the last entry for it
+static void forgetEntry(const QString& filePath)
+{
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    // Unless the file got a new entry in the meantime
+    if (!r.entries.value(filePath).isNull())
+        return;
+    r.entries.remove(filePath);
+    if (r.watcher)
+        r.watcher->removePath(filePath);
+}
+
+// Entries may die on any thread and with the registry mutex held, the watcher
+// is updated later on the gui thread
+static void deleteEntry(PixelPerfectIconEngineEntry* entry)
+{
+    if (!entry->bundle && qApp) {
+        QMetaObject::invokeMethod(
+            qApp,
+            [filePath = entry->filePath] { forgetEntry(filePath); },
+            Qt::QueuedConnection);
+    }
+    delete entry;
+}
+
+// Called with the registry mutex held. Null unless the path is a valid bundle
+static QSharedPointer<PixelPerfectIconBundle> openBundle(
+    PixelPerfectIconEngineRegistry& r, const QString& filePath)
+{
+    auto it = r.bundles.constFind(filePath);
+    if (it != r.bundles.cend())
+        return *it;
+
+    QSharedPointer<PixelPerfectIconBundle> bundle;
+    if (QFileInfo(filePath).isFile()) {
+        bundle.reset(new PixelPerfectIconBundle(filePath));
+        if (!bundle->isValid()) {
+            qWarning("Invalid icon bundle: %s", qUtf8Printable(filePath));
+            bundle.reset();
+        }
+    }
+    r.bundles.insert(filePath, bundle);
+    return bundle;
+}
+
+// Called with the registry mutex held
+static void bindBundle(PixelPerfectIconEngineRegistry& r,
+                       PixelPerfectIconEngineEntry* entry)
+{
+    const QFileInfo info(entry->filePath);
+    entry->bundle = openBundle(r, info.absolutePath());
+    entry->bundleIndex = entry->bundle ? entry->bundle->indexOf(info.fileName()) : -1;
+}
+
+// Called with the registry mutex held
+static PixelPerfectIconEngineEntryPointer acquireEntry(
+    PixelPerfectIconEngineRegistry& r,
+    const QString& filePath,
+    const QSharedPointer<PixelPerfectIconBundle>& bundle)
+{
+    PixelPerfectIconEngineEntryPointer entry = r.entries.value(filePath).toStrongRef();
+    if (!entry) {
+        const int bundleIndex = bundle ? bundle->indexOf(QFileInfo(filePath).fileName())
+                                       : -1;
+        entry.reset(new PixelPerfectIconEngineEntry{.filePath = filePath,
+                                                    .fileSize = 0,
+                                                    .fileId = 0,
+                                                    .fileHash = 0,
+                                                    .bundle = bundle,
+                                                    .bundleIndex = bundleIndex},
+                    deleteEntry);
+        refreshEntry(entry.get());
+        r.entries.insert(filePath, entry);
+        if (r.watcher && !bundle)
+            r.watcher->addPath(filePath);
+    }
+    return entry;
+}
+
+// Called with the registry mutex held. Trusts the stored size and hash as long
+// as the file looks the same, so no image headers are read
+static PixelPerfectIconEngineEntryPointer restoreEntry(
+    PixelPerfectIconEngineRegistry& r, const PixelPerfectIconEngineEntry& stored)
+{
+    PixelPerfectIconEngineEntryPointer entry = r.entries.value(stored.filePath)
+                                                   .toStrongRef();
+    if (!entry) {
+        entry.reset(new PixelPerfectIconEngineEntry(stored), deleteEntry);
+        entry->fileId = nextFileId();
+        bindBundle(r, entry.get());
+        refreshEntry(entry.get());
+        r.entries.insert(stored.filePath, entry);
+        if (r.watcher && !entry->bundle)
+            r.watcher->addPath(stored.filePath);
+    }
+    return entry;
+}
+
+static void writeEntries(QDataStream& out,
+                         const PixelPerfectIconEngineEntryMap& entries)
+{
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    out << qint32(entries.size());
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        const PixelPerfectIconEngineEntry& entry = *it.value();
+        out << qint32(it.key()) << entry.filePath << entry.size << entry.lastModified
+            << qint64(entry.fileSize) << quint64(entry.fileHash);
+    }
+}
+
+static bool readEntries(QDataStream& in, PixelPerfectIconEngineEntryMap* entries)
+{
+    qint32 count = 0;
+    in >> count;
+
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint32 dpi = 0;
+        PixelPerfectIconEngineEntry stored{.fileSize = 0,
+                                           .fileId = 0,
+                                           .fileHash = 0,
+                                           .bundle = {},
+                                           .bundleIndex = -1};
+        in >> dpi >> stored.filePath >> stored.size >> stored.lastModified
+            >> stored.fileSize >> stored.fileHash;
+        if (in.status() == QDataStream::Ok)
+            entries->insert(dpi, restoreEntry(r, stored));
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+// Variants are named as base[.dark][.dpi].suffix, the key is base.suffix
+static bool parseVariantName(QStringView fileName, QString* key, bool* dark, int* dpi)
+{
+    QStringView rest(fileName);
+    const qsizetype dot = rest.indexOf(u'.');
+    if (dot <= 0)
+        return false;
+    const QStringView baseName = rest.first(dot);
+    rest = rest.sliced(dot + 1);
+
+    *dark = rest.startsWith(u"dark.");
+    if (*dark)
+        rest = rest.sliced(5);
+
+    *dpi = 100;
+    if (rest.size() > 4 && rest.at(3) == u'.' && rest.at(0).isDigit()
+        && rest.at(1).isDigit() && rest.at(2).isDigit()) {
+        *dpi = rest.first(3).toInt();
+        rest = rest.sliced(4);
+    }
+
+    *key = baseName % u'.' % rest;
+    return true;
+}
+
+static PixelPerfectIconEngineDirectory scanDirectory(const QString& dirPath,
+                                                     const QStringList& fileNames)
+{
+    PixelPerfectIconEngineDirectory directory;
+    const QDir dir(dirPath);
+    for (const QString& fileName : fileNames) {
+        QString key;
+        bool dark = false;
+        int dpi = 100;
+        if (parseVariantName(fileName, &key, &dark, &dpi)) {
+            (dark ? directory.filePathsDark : directory.filePaths)[key]
+                .insert(dpi, dir.absoluteFilePath(fileName));
+        }
+    }
+    return directory;
+}
+
+static PixelPerfectIconEngineVariants variants(const QString& filePath)
+{
+    const QFileInfo info(filePath);
+    const QString& dirPath = info.absolutePath();
+    const QString& fileName = info.fileName();
+
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+
+    // Bundles are indexed just like directories
+    auto directory = r.directories.find(dirPath);
+    if (directory == r.directories.end()) {
+        const QSharedPointer<PixelPerfectIconBundle>& bundle = openBundle(r, dirPath);
+        const QStringList& fileNames = bundle ? bundle->fileNames()
+                                              : QDir(dirPath).entryList(QDir::Files);
+        directory = r.directories.insert(dirPath, scanDirectory(dirPath, fileNames));
+        directory->bundle = bundle;
+    }
+
+    auto it = directory->variants.constFind(fileName);
+    if (it != directory->variants.cend())
+        return *it;
+
+    // The file asked for must exist, even when other variants of it do
+    QString key;
+    bool dark = false;
+    int dpi = 100;
+    const QString& absoluteFilePath = QDir(dirPath).absoluteFilePath(fileName);
+    if (!parseVariantName(fileName, &key, &dark, &dpi)
+        || (dark ? directory->filePathsDark : directory->filePaths)
+                   .value(key)
+                   .value(dpi)
+               != absoluteFilePath) {
+        return {};
+    }
+
+    // Variants asked for by their own name are drawn as they are
+    PixelPerfectIconEngineVariants found;
+    if (key != fileName) {
+        found.entries.insert(100,
+                             acquireEntry(r, absoluteFilePath, directory->bundle));
+        directory->variants.insert(fileName, found);
+        return found;
+    }
+
+    const QMap<int, QString>& filePaths = directory->filePaths.value(fileName);
+    for (auto i = filePaths.cbegin(); i != filePaths.cend(); ++i)
+        found.entries.insert(i.key(), acquireEntry(r, i.value(), directory->bundle));
+    const QMap<int, QString>& filePathsDark = directory->filePathsDark.value(fileName);
+    for (auto i = filePathsDark.cbegin(); i != filePathsDark.cend(); ++i)
+        found.entriesDark.insert(i.key(),
+                                 acquireEntry(r, i.value(), directory->bundle));
+    directory->variants.insert(fileName, found);
+    return found;
+}
+
+static bool chooseVariant(const PixelPerfectIconEngineEntryMap& entries,
+                          const QSizeF& requestedSize,
+                          PixelPerfectIconEngineEntryPointer* match,
+                          qreal* scale)
+{
+    const qreal rw = requestedSize.width();
+    const qreal rh = requestedSize.height();
+
+    // Try integer upscaling for a crisper look
+    PixelPerfectIconEngineEntryMapIterator i(entries);
+    i.toBack();
+    while (i.hasPrevious()) {
+        i.previous();
+        int iw = i.value()->size.width();
+        int ih = i.value()->size.height();
+        int s = qMin(qFloor(rw / iw), qFloor(rh / ih));
+
+        if (s >= 1 && (rw - iw * s < rw * 0.21 || rh - ih * s < rh * 0.21)) {
+            *match = i.value();
+            *scale = s;
+            return true;
+        }
+    }
+
+    // Oops, integer upscaling didn't work. Let's try the direct approach
+    i.toBack();
+    while (i.hasPrevious()) {
+        i.previous();
+        qreal s = qMin(rw / i.value()->size.width(), rh / i.value()->size.height());
+
+        if (s >= 1) {
+            *match = i.value();
+            *scale = s;
+            return true;
+        }
+    }
+
+    // Downscale the smallest
+    i.toFront();
+    while (i.hasNext()) {
+        i.next();
+        qreal s = qMin(rw / i.value()->size.width(), rh / i.value()->size.height());
+
+        if (s <= 1.0) {
+            *match = i.value();
+            *scale = s;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 PixelPerfectIconEngine::PixelPerfectIconEngine(const QString& filePath)
     : QIconEngine()
+    , m_variantGeneration(0)
+    , m_dark(QGuiApplication::styleHints()->colorScheme() == Qt::ColorScheme::Dark)
+    , m_pendingDark(m_dark)
+    , m_switchGeneration(0)
+    , m_pendingRasters(0)
 {
     init(filePath);
+    registerEngine();
 }
 
 PixelPerfectIconEngine::PixelPerfectIconEngine(const PixelPerfectIconEngine& other)
     : QIconEngine(other)
     , m_entries(other.m_entries)
     , m_entriesDark(other.m_entriesDark)
-{}
+    , m_selections(other.m_selections)
+    , m_variantGeneration(other.m_variantGeneration.load())
+    , m_dark(other.m_pendingDark) // Switches in progress are not sent to clones
+    , m_pendingDark(m_dark)
+    , m_switchGeneration(0)
+    , m_pendingRasters(0)
+{
+    registerEngine();
+}
+
+PixelPerfectIconEngine::~PixelPerfectIconEngine()
+{
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.engines.remove(this);
+}
 
 QIconEngine* PixelPerfectIconEngine::clone() const
 {
     return new PixelPerfectIconEngine(*this);
 }
 
+bool PixelPerfectIconEngine::read(QDataStream& in)
+{
+    PixelPerfectIconEngineEntryMap entries;
+    PixelPerfectIconEngineEntryMap entriesDark;
+    quint8 version = 0;
+    in >> version;
+    const bool ok = version == streamVersion && readEntries(in, &entries)
+                    && readEntries(in, &entriesDark);
+
+    // Invalidation looks through the entries of every engine
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    m_entries = entries;
+    m_entriesDark = entriesDark;
+    m_selections.clear();
+    return ok;
+}
+
+bool PixelPerfectIconEngine::write(QDataStream& out) const
+{
+    out << streamVersion;
+    writeEntries(out, m_entries);
+    writeEntries(out, m_entriesDark);
+    return out.status() == QDataStream::Ok;
+}
+
 void PixelPerfectIconEngine::paint(QPainter* painter,
                                    const QRect& rect,
                                    QIcon::Mode mode,
                                    QIcon::State state)
 {
-    Q_UNUSED(mode)
-    Q_UNUSED(state)
-    const QPixmap& px
-        = bestMatch(rect.size(), painter->device()->devicePixelRatio(), mode, state);
-    QRectF pRect({0, 0}, QSizeF(px.size()) / px.devicePixelRatio());
-    pRect.moveCenter(QRectF(rect).center());
-    painter->drawPixmap(int(qMax(pRect.x(), qreal(rect.x()))),
-                        int(qMax(pRect.y(), qreal(rect.y()))),
-                        px);
+    paintTinted(painter, rect, mode, state, QColor());
+}
+
+// Painting with an invalid color leaves the icon as it is
+void PixelPerfectIconEngine::paintTinted(QPainter* painter,
+                                         const QRect& rect,
+                                         QIcon::Mode mode,
+                                         QIcon::State state,
+                                         const QColor& color) const
+{
+    const QRgb tint = color.isValid() ? color.rgba() : 0;
+    if (color.isValid() && qAlpha(tint) == 0)
+        return;
+
+    if (distanceFieldEnabled && paintDistanceField(painter, rect, mode, tint))
+        return;
+
+    // Widgets and windows painting themselves can wait for a raster, the
+    // others expect the icon to be there when paint returns
+    QPaintDevice* device = painter->device();
+    const PixelPerfectIconAtlasSlot& slot = bestMatch(rect.size(),
+                                                      device->devicePixelRatio(),
+                                                      mode,
+                                                      state,
+                                                      tint,
+                                                      dynamic_cast<QObject*>(device));
+    if (!slot.pixmap)
+        return;
+    const QSizeF& size = QSizeF(slot.rect.size()) / slot.devicePixelRatio;
+    painter->drawPixmap(iconRect(rect, size), *slot.pixmap, slot.rect);
+}
+
+// Single color icons are drawn straight from their distance field at any size
+// and color, nothing but the field is cached
+bool PixelPerfectIconEngine::paintDistanceField(QPainter* painter,
+                                                const QRect& rect,
+                                                QIcon::Mode mode,
+                                                QRgb tint) const
+{
+    const qreal devicePixelRatio = painter->device()->devicePixelRatio();
+    const PixelPerfectIconEngineSelection& selection
+        = selectVariant(rect.size(), devicePixelRatio, m_dark);
+    if (!selection.match)
+        return false;
+
+    const PixelPerfectDistanceField* field
+        = distanceField(*selection.match, dynamic_cast<QObject*>(painter->device()));
+    if (!field)
+        return false;
+
+    const QRgb highlight = highlightFor(mode);
+    dropStaleHighlight(highlight);
+    QImage image = field->render(selection.targetSize, field->color());
+    generate(&image, mode, tint, highlight);
+    painter->drawImage(iconRect(rect, QSizeF(image.size()) / devicePixelRatio), image);
+    return true;
 }
 
 void PixelPerfectIconEngine::init(const QString& filePath)
@@ -58,223 +941,399 @@ void PixelPerfectIconEngine::init(const QString& filePath)
     if (filePath.isEmpty())
         return;
 
-    QFileInfo info(filePath);
-    if (!info.exists() || info.isDir()) {
+    const PixelPerfectIconEngineVariants& found = variants(filePath);
+    if (found.entries.isEmpty() && found.entriesDark.isEmpty()) {
         qWarning("Invalid icon path provided: %s", qUtf8Printable(filePath));
         return;
     }
 
-    const QDir& dir = info.dir();
-    const QStringList& fileNames
-        = dir.entryList({u"%1*.%2"_s.arg(info.baseName(), info.completeSuffix())},
-                        QDir::Files);
+    m_entries = found.entries;
+    m_entriesDark = found.entriesDark;
+}
+
+// Engines follow the color scheme through a single subscription, which also
+// needs to know the engines alive
+void PixelPerfectIconEngine::registerEngine()
+{
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.engines.insert(this);
+    if (!r.colorSchemeSubscribed && qApp) {
+        r.colorSchemeSubscribed = true;
+        QObject::connect(QGuiApplication::styleHints(),
+                         &QStyleHints::colorSchemeChanged,
+                         qApp,
+                         &PixelPerfectIconEngine::updateColorScheme);
+    }
+}
+
+void PixelPerfectIconEngine::updateColorScheme(Qt::ColorScheme colorScheme)
+{
+    static quint64 lastGeneration = 0;
+    const quint64 generation = ++lastGeneration;
 
-    // Collect light variants
-    QRegularExpression rel(
-        u"%1(\\.(\\d{3}))?\\.%2"_s.arg(info.baseName(), info.completeSuffix()));
-    const QStringList& fileNamesLight = fileNames.filter(rel);
-    for (const QString& fileName : fileNamesLight) {
-        QImageReader reader(dir.absoluteFilePath(fileName));
-        QRegularExpressionMatch match = rel.match(fileName);
-        bool ok = false;
-        int dpi = match.captured(2).toInt(&ok);
-        m_entries.insert(ok ? dpi : 100, {reader.size(), reader.fileName()});
+    PixelPerfectIconEngineRegistry& r = registry();
+    QList<PixelPerfectIconEngine*> engines;
+    {
+        QMutexLocker locker(&r.mutex);
+        engines = r.engines.values();
     }
 
-    // Collect dark variants
-    QRegularExpression red(
-        u"%1\\.dark(\\.(\\d{3}))?\\.%2"_s.arg(info.baseName(), info.completeSuffix()));
-    const QStringList& fileNamesDark = fileNames.filter(red);
-    for (const QString& fileName : fileNamesDark) {
-        QImageReader reader(dir.absoluteFilePath(fileName));
-        QRegularExpressionMatch match = red.match(fileName);
-        bool ok = false;
-        int dpi = match.captured(2).toInt(&ok);
-        m_entriesDark.insert(ok ? dpi : 100, {reader.size(), reader.fileName()});
+    const bool dark = colorScheme == Qt::ColorScheme::Dark;
+    for (PixelPerfectIconEngine* engine : std::as_const(engines))
+        engine->switchColorScheme(dark, generation);
+}
+
+// Engines keep painting with the previous scheme until the sizes they were
+// painted at are rasterized for the new one, so no frame misses the cache
+void PixelPerfectIconEngine::switchColorScheme(bool dark, quint64 generation)
+{
+    m_pendingDark = dark;
+    m_switchGeneration = generation;
+    m_pendingRasters = 0;
+
+    m_usages.removeIf([](const PixelPerfectIconEngineUsage& usage) {
+        return !usage.updateTarget;
+    });
+
+    for (const PixelPerfectIconEngineUsage& usage : std::as_const(m_usages)) {
+        const auto done = [this, generation] {
+            PixelPerfectIconEngineRegistry& r = registry();
+            {
+                QMutexLocker locker(&r.mutex);
+                if (!r.engines.contains(this))
+                    return;
+            }
+            finishColorSchemeSwitch(generation);
+        };
+        if (prerasterize(usage.size,
+                         usage.devicePixelRatio,
+                         usage.mode,
+                         usage.state,
+                         usage.tint,
+                         dark,
+                         done)) {
+            ++m_pendingRasters;
+        }
+    }
+
+    ++m_pendingRasters;
+    finishColorSchemeSwitch(generation);
+}
+
+void PixelPerfectIconEngine::finishColorSchemeSwitch(quint64 generation)
+{
+    // Left over from a previous switch
+    if (generation != m_switchGeneration || --m_pendingRasters > 0)
+        return;
+
+    m_dark = m_pendingDark;
+    for (const PixelPerfectIconEngineUsage& usage : std::as_const(m_usages)) {
+        if (usage.updateTarget)
+            QMetaObject::invokeMethod(usage.updateTarget, "update");
     }
 }
 
 const PixelPerfectIconEngineEntryMap& PixelPerfectIconEngine::activeEntries() const
 {
-    return QGuiApplication::styleHints()->colorScheme() == Qt::ColorScheme::Dark
-               ? (m_entriesDark.isEmpty() ? m_entries : m_entriesDark)
-               : (m_entries.isEmpty() ? m_entriesDark : m_entries);
+    return activeEntries(m_dark);
+}
+
+const PixelPerfectIconEngineEntryMap& PixelPerfectIconEngine::activeEntries(
+    bool dark) const
+{
+    return dark ? (m_entriesDark.isEmpty() ? m_entries : m_entriesDark)
+                : (m_entries.isEmpty() ? m_entriesDark : m_entries);
+}
+
+// Rasters of generated modes depend on the palette, hence the color scheme and
+// the highlight color
+quint64 PixelPerfectIconEngine::diskKeyFor(const PixelPerfectIconEngineEntry& entry,
+                                           const QSize& size,
+                                           qreal devicePixelRatio,
+                                           QIcon::Mode mode,
+                                           QIcon::State state,
+                                           bool dark,
+                                           QRgb tint) const
+{
+    const quint64 fields[] = {
+        entry.fileHash,
+        quint64(size.width()),
+        quint64(size.height()),
+        quint64(qRound(devicePixelRatio * 1000)),
+        quint64(mode),
+        quint64(state),
+        quint64(tint),
+        quint64(dark),
+        quint64(highlightFor(mode)),
+    };
+
+    // FNV-1a, qHash is seeded per process
+    quint64 key = 0xcbf29ce484222325;
+    for (quint64 field : fields) {
+        for (int i = 0; i < 8; ++i) {
+            key ^= (field >> (i * 8)) & 0xff;
+            key *= 0x100000001b3;
+        }
+    }
+    return key;
+}
+
+PixelPerfectPixmapKey PixelPerfectIconEngine::cacheKeyFor(
+    const PixelPerfectIconEngineEntry& entry,
+    const QSize& size,
+    qreal devicePixelRatio,
+    QIcon::Mode mode,
+    QIcon::State state,
+    QRgb tint) const
+{
+    // Ratios above 65 do not fit into the thousandths of the key
+    const int thousandths = qBound(1, qRound(devicePixelRatio * 1000), 0xffff);
+    return PixelPerfectPixmapKey{.fileId = entry.fileId,
+                                 .width = size.width(),
+                                 .height = size.height(),
+                                 .devicePixelRatio = quint16(thousandths),
+                                 .mode = quint8(mode),
+                                 .state = quint8(state),
+                                 .tint = tint,
+                                 .highlight = highlightFor(mode)};
 }
 
-QString PixelPerfectIconEngine::cacheKeyFor(const QString& filePath,
-                                            const QSize& size,
-                                            qreal devicePixelRatio,
-                                            QIcon::Mode mode,
-                                            QIcon::State state) const
+// Selection only depends on the requested device size and the variant sizes,
+// so it runs once per size and pixel ratio until one of the variants changes
+PixelPerfectIconEngineSelection PixelPerfectIconEngine::selectVariant(
+    const QSize& size, qreal devicePixelRatio, bool dark) const
 {
-    QFileInfo info(filePath);
-    return key()
-           % info.canonicalFilePath()
-           % HexString<uint>(info.lastModified(QTimeZone::UTC).toSecsSinceEpoch())
-           % HexString<quint64>(info.size())
-           % HexString<uint>(size.width())
-           % HexString<uint>(size.height())
-           % HexString<quint8>(mode)
-           % HexString<quint8>(state)
-           % HexString<quint16>(qRound(devicePixelRatio * 1000));
+    const quint64 key = quint64(qBound(0, size.width(), 0xffff))
+                        | quint64(qBound(0, size.height(), 0xffff)) << 16
+                        | quint64(qRound(devicePixelRatio * 1000) & 0xffff) << 32
+                        | quint64(dark) << 48;
+    const quint64 generation = m_variantGeneration;
+    if (auto it = m_selections.constFind(key);
+        it != m_selections.cend() && it->generation == generation) {
+        return *it;
+    }
+
+    PixelPerfectIconEngineSelection selection{.match = {},
+                                              .scale = 0,
+                                              .targetSize = QSize(),
+                                              .generation = generation};
+    // Entries are refreshed under the registry mutex, the selection keeps a copy
+    const QRect& requestedRect = greaterRect(size, devicePixelRatio);
+    {
+        PixelPerfectIconEngineRegistry& r = registry();
+        QMutexLocker locker(&r.mutex);
+        PixelPerfectIconEngineEntryPointer match;
+        if (chooseVariant(activeEntries(dark),
+                          requestedRect.size(),
+                          &match,
+                          &selection.scale)) {
+            selection.match.reset(new PixelPerfectIconEngineEntry(*match));
+        }
+    }
+    if (selection.match) {
+        selection.targetSize = greaterRect(selection.match->size, selection.scale)
+                                   .size();
+    }
+
+    if (m_selections.size() >= maxSelections)
+        m_selections.clear();
+    m_selections.insert(key, selection);
+    return selection;
 }
 
-QPixmap PixelPerfectIconEngine::bestMatch(const QSize& size,
+// Other modes and tints come from the normal raster without decoding the file
+// again, as long as it's still in the atlas
+bool PixelPerfectIconEngine::deriveRaster(const PixelPerfectIconEngineEntry& entry,
+                                          const QSize& targetSize,
                                           qreal devicePixelRatio,
                                           QIcon::Mode mode,
-                                          QIcon::State state) const
+                                          QIcon::State state,
+                                          QRgb tint,
+                                          QImage* image) const
 {
-    QPixmap px;
-    const QSizeF& requestedSize = greaterRect(size, devicePixelRatio).size();
-    const qreal rw = requestedSize.width();
-    const qreal rh = requestedSize.height();
+    if (mode == QIcon::Normal && !tint)
+        return false;
 
-    // Try integer upscaling for a crisper look
-    PixelPerfectIconEngineEntryMapIterator i(activeEntries());
-    i.toBack();
-    while (i.hasPrevious()) {
-        i.previous();
-        int iw = i.value().size.width();
-        int ih = i.value().size.height();
-        int scale = qMin(qFloor(rw / iw), qFloor(rh / ih));
-
-        if (scale >= 1 && (rw - iw * scale < rw * 0.21 || rh - ih * scale < rh * 0.21)) {
-            const QString& cacheKey
-                = cacheKeyFor(i.value().filePath, i.value().size, scale, mode, state);
-            if (!QPixmapCache::find(cacheKey, &px)) {
-                QImageReader reader(i.value().filePath);
-                if (scale > 1) {
-                    if (reader.supportsOption(QImageIOHandler::ScaledSize)) {
-                        reader.setScaledSize(scale * i.value().size);
-                        px = QPixmap::fromImage(reader.read());
-                    } else {
-                        QPixmap pxx(scale * i.value().size);
-                        pxx.fill(Qt::transparent);
-                        QPainter painter(&pxx);
-                        painter.setRenderHints(QPainter::Antialiasing
-                                               | QPainter::TextAntialiasing
-                                               | QPainter::SmoothPixmapTransform
-                                               | QPainter::LosslessImageRendering);
-                        painter.scale(scale, scale);
-                        painter.drawImage(QPoint{0, 0}, reader.read());
-                        painter.end();
-                        px = pxx;
-                    }
-                } else {
-                    px = QPixmap::fromImage(reader.read());
-                }
-                if (mode != QIcon::Normal) {
-                    QPixmap generated = px;
-                    if (QGuiApplication* guiApp = qobject_cast<QGuiApplication*>(qApp))
-                        generated = static_cast<QGuiApplicationPrivate*>(QObjectPrivate::get(guiApp))
-                                        ->applyQIconStyleHelper(mode, px);
-                    if (!generated.isNull())
-                        px = generated;
-                }
-                px.setDevicePixelRatio(devicePixelRatio);
-                QPixmapCache::insert(cacheKey, px);
-            }
-            return px;
+    PixelPerfectIconAtlasSlot slot;
+    if (!PixelPerfectIconAtlas::instance()->find(
+            cacheKeyFor(entry, targetSize, devicePixelRatio, QIcon::Normal, state),
+            &slot)) {
+        return false;
+    }
+
+    // The only copy, the image is its sole owner once the temporary is gone
+    *image = slot.pixmap->copy(slot.rect).toImage();
+    generate(image, mode, tint, highlightFor(mode));
+    return true;
+}
+
+PixelPerfectIconAtlasSlot PixelPerfectIconEngine::bestMatch(const QSize& size,
+                                                            qreal devicePixelRatio,
+                                                            QIcon::Mode mode,
+                                                            QIcon::State state,
+                                                            QRgb tint,
+                                                            QObject* updateTarget) const
+{
+    if (mode == QIcon::Active)
+        mode = QIcon::Normal;
+
+    PixelPerfectIconAtlas* atlas = PixelPerfectIconAtlas::instance();
+    PixelPerfectIconAtlasSlot slot{.pixmap = nullptr,
+                                   .rect = QRect(),
+                                   .devicePixelRatio = 1.0};
+    const PixelPerfectIconEngineSelection& selection
+        = selectVariant(size, devicePixelRatio, m_dark);
+    if (!selection.match)
+        return slot;
+
+    if (updateTarget) {
+        const auto usage = std::find_if(m_usages.begin(),
+                                        m_usages.end(),
+                                        [&](const PixelPerfectIconEngineUsage& u) {
+                                            return u.size == size
+                                                   && u.devicePixelRatio
+                                                          == devicePixelRatio
+                                                   && u.mode == mode
+                                                   && u.state == state
+                                                   && u.tint == tint;
+                                        });
+        if (usage != m_usages.end()) {
+            usage->updateTarget = updateTarget;
+        } else {
+            if (m_usages.size() >= maxUsages)
+                m_usages.removeFirst();
+            m_usages.append({size, devicePixelRatio, mode, state, tint, updateTarget});
         }
     }
 
-    // Oops, integer upscaling didn't work. Let's try the direct approach
-    i.toBack();
-    while (i.hasPrevious()) {
-        i.previous();
-        int iw = i.value().size.width();
-        int ih = i.value().size.height();
-        qreal scale = qMin(rw / iw, rh / ih);
-
-        if (scale >= 1) {
-            const QString& cacheKey
-                = cacheKeyFor(i.value().filePath, i.value().size, scale, mode, state);
-            if (!QPixmapCache::find(cacheKey, &px)) {
-                QImageReader reader(i.value().filePath);
-                if (qFuzzyCompare(scale, 1.0)) {
-                    px = QPixmap::fromImage(reader.read());
-                } else {
-                    if (reader.supportsOption(QImageIOHandler::ScaledSize)) {
-                        reader.setScaledSize(greaterRect(i.value().size, scale).size());
-                        px = QPixmap::fromImage(reader.read());
-                    } else {
-                        QPixmap pxx(greaterRect(i.value().size, scale).size());
-                        pxx.fill(Qt::transparent);
-                        QPainter painter(&pxx);
-                        painter.setRenderHints(QPainter::Antialiasing
-                                               | QPainter::TextAntialiasing
-                                               | QPainter::SmoothPixmapTransform
-                                               | QPainter::LosslessImageRendering);
-                        painter.scale(scale, scale);
-                        painter.drawImage(QPoint{0, 0}, reader.read());
-                        painter.end();
-                        px = pxx;
-                    }
-                }
-                if (mode != QIcon::Normal) {
-                    QPixmap generated = px;
-                    if (QGuiApplication* guiApp = qobject_cast<QGuiApplication*>(qApp))
-                        generated = static_cast<QGuiApplicationPrivate*>(QObjectPrivate::get(guiApp))
-                                        ->applyQIconStyleHelper(mode, px);
-                    if (!generated.isNull())
-                        px = generated;
-                }
-                px.setDevicePixelRatio(devicePixelRatio);
-                QPixmapCache::insert(cacheKey, px);
-            }
-            return px;
+    const PixelPerfectIconEngineEntryPointer& match = selection.match;
+    const qreal scale = selection.scale;
+    const QSize& targetSize = selection.targetSize;
+    const PixelPerfectPixmapKey& cacheKey
+        = cacheKeyFor(*match, targetSize, devicePixelRatio, mode, state, tint);
+    dropStaleHighlight(cacheKey.highlight);
+    if (atlas->find(cacheKey, &slot)) {
+        ++pixmapStatistics.hits;
+        return slot;
+    }
+    ++pixmapStatistics.misses;
+    if (nullRasters().contains(cacheKey))
+        return slot;
+
+    const quint64 diskKey
+        = diskKeyFor(*match, targetSize, devicePixelRatio, mode, state, m_dark, tint);
+    // Copied out of the mapped pack, the atlas takes the copy over
+    QImage image;
+    if (PixelPerfectDiskCache::instance()->find(diskKey, &image))
+        return atlas->insert(cacheKey, std::move(image));
+
+    if (deriveRaster(*match, targetSize, devicePixelRatio, mode, state, tint, &image)) {
+        PixelPerfectDiskCache::instance()->insert(diskKey, image);
+        return atlas->insert(cacheKey, std::move(image));
+    }
+
+    if (!updateTarget || !asynchronous) {
+        image = rasterize(*match, scale);
+        if (image.isNull()) {
+            nullRasters().insert(cacheKey);
+            return slot;
         }
+        generate(&image, mode, tint, cacheKey.highlight);
+        PixelPerfectDiskCache::instance()->insert(diskKey, image);
+        return atlas->insert(cacheKey, std::move(image));
     }
 
-    // Downscale the smallest
-    i.toFront();
-    while (i.hasNext()) {
-        i.next();
-        int iw = i.value().size.width();
-        int ih = i.value().size.height();
-        qreal scale = qMin(rw / iw, rh / ih);
-
-        if (scale <= 1.0) {
-            const QString& cacheKey
-                = cacheKeyFor(i.value().filePath, i.value().size, scale, mode, state);
-            if (!QPixmapCache::find(cacheKey, &px)) {
-                QImageReader reader(i.value().filePath);
-                if (qFuzzyCompare(scale, 1.0)) {
-                    px = QPixmap::fromImage(reader.read());
-                } else {
-                    if (reader.supportsOption(QImageIOHandler::ScaledSize)) {
-                        reader.setScaledSize(greaterRect(i.value().size, scale).size());
-                        px = QPixmap::fromImage(reader.read());
-                    } else {
-                        QPixmap pxx(greaterRect(i.value().size, scale).size());
-                        pxx.fill(Qt::transparent);
-                        QPainter painter(&pxx);
-                        painter.setRenderHints(QPainter::Antialiasing
-                                               | QPainter::TextAntialiasing
-                                               | QPainter::SmoothPixmapTransform
-                                               | QPainter::LosslessImageRendering);
-                        painter.scale(scale, scale);
-                        painter.drawImage(QPoint{0, 0}, reader.read());
-                        painter.end();
-                        px = pxx;
-                    }
-                }
-                if (mode != QIcon::Normal) {
-                    QPixmap generated = px;
-                    if (QGuiApplication* guiApp = qobject_cast<QGuiApplication*>(qApp))
-                        generated = static_cast<QGuiApplicationPrivate*>(QObjectPrivate::get(guiApp))
-                                        ->applyQIconStyleHelper(mode, px);
-                    if (!generated.isNull())
-                        px = generated;
-                }
-                px.setDevicePixelRatio(devicePixelRatio);
-                QPixmapCache::insert(cacheKey, px);
-            }
-            return px;
+    requestRaster(cacheKey,
+                  diskKey,
+                  *match,
+                  scale,
+                  mode,
+                  updateTarget);
+
+    // Draw the closest raster we have at the expected size until then
+    QList<PixelPerfectPixmapKey> candidates{cacheKey};
+    {
+        PixelPerfectIconEngineRegistry& r = registry();
+        QMutexLocker locker(&r.mutex);
+        for (const PixelPerfectIconEngineEntryPointer& entry : activeEntries()) {
+            candidates.append(
+                cacheKeyFor(*entry, targetSize, devicePixelRatio, mode, state, tint));
+        }
+    }
+    for (const PixelPerfectPixmapKey& candidate : std::as_const(candidates)) {
+        if (atlas->findNearest(candidate, &slot)) {
+            slot.devicePixelRatio = slot.rect.width() * devicePixelRatio
+                                    / targetSize.width();
+            return slot;
         }
     }
 
-    return px;
+    return slot;
+}
+
+bool PixelPerfectIconEngine::prewarm(const QSize& size,
+                                     qreal devicePixelRatio,
+                                     QIcon::Mode mode,
+                                     QIcon::State state,
+                                     const std::function<void()>& done) const
+{
+    return prerasterize(size, devicePixelRatio, mode, state, 0, m_dark, done);
+}
+
+// Requests the raster in the background unless it's already cached
+bool PixelPerfectIconEngine::prerasterize(const QSize& size,
+                                          qreal devicePixelRatio,
+                                          QIcon::Mode mode,
+                                          QIcon::State state,
+                                          QRgb tint,
+                                          bool dark,
+                                          const std::function<void()>& done) const
+{
+    if (mode == QIcon::Active)
+        mode = QIcon::Normal;
+
+    const PixelPerfectIconEngineSelection& selection
+        = selectVariant(size, devicePixelRatio, dark);
+    if (!selection.match)
+        return false;
+
+    const PixelPerfectIconEngineEntryPointer& match = selection.match;
+    if (distanceFieldEnabled && distanceField(*match, nullptr))
+        return false;
+
+    const qreal scale = selection.scale;
+    const QSize& targetSize = selection.targetSize;
+    const PixelPerfectPixmapKey& cacheKey
+        = cacheKeyFor(*match, targetSize, devicePixelRatio, mode, state, tint);
+    PixelPerfectIconAtlasSlot slot;
+    if (PixelPerfectIconAtlas::instance()->find(cacheKey, &slot)
+        || nullRasters().contains(cacheKey)) {
+        return false;
+    }
+
+    const quint64 diskKey
+        = diskKeyFor(*match, targetSize, devicePixelRatio, mode, state, dark, tint);
+    QImage image;
+    if (PixelPerfectDiskCache::instance()->find(diskKey, &image)) {
+        PixelPerfectIconAtlas::instance()->insert(cacheKey, std::move(image));
+        return false;
+    }
+
+    if (deriveRaster(*match, targetSize, devicePixelRatio, mode, state, tint, &image)) {
+        PixelPerfectDiskCache::instance()->insert(diskKey, image);
+        PixelPerfectIconAtlas::instance()->insert(cacheKey, std::move(image));
+        return false;
+    }
+
+    requestRaster(cacheKey,
+                  diskKey,
+                  *match,
+                  scale,
+                  mode,
+                  nullptr,
+                  done);
+    return true;
 }
 
 QRect PixelPerfectIconEngine::greaterRect(const QSize& size,
@@ -300,10 +1359,13 @@ QPixmap PixelPerfectIconEngine::scaledPixmap(const QSize& size,
     if (isNull() || !size.isValid())
         return QPixmap();
 
-    QPixmap px(greaterRect(size, scale).size());
-    const QString& cacheKey
-        = cacheKeyFor(activeEntries().first().filePath, size, scale, mode, state);
-    if (!QPixmapCache::find(cacheKey, &px)) {
+    // Allocated on misses only, hits share the cached pixmap
+    QPixmap px;
+    const PixelPerfectPixmapKey& cacheKey
+        = cacheKeyFor(*activeEntries().first(), size, scale, mode, state);
+    dropStaleHighlight(cacheKey.highlight);
+    if (!findPixmap(cacheKey, &px)) {
+        px = QPixmap(greaterRect(size, scale).size());
         px.fill(Qt::transparent);
         QPainter painter(&px);
         painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing
@@ -312,7 +1374,7 @@ QPixmap PixelPerfectIconEngine::scaledPixmap(const QSize& size,
         paint(&painter, QRect({0, 0}, size), mode, state);
         painter.end();
         px.setDevicePixelRatio(scale);
-        QPixmapCache::insert(cacheKey, px);
+        insertPixmap(cacheKey, px);
     }
     return px;
 }
@@ -326,7 +1388,7 @@ QString PixelPerfectIconEngine::iconName() const
 {
     if (isNull())
         return QString();
-    return activeEntries().first().filePath;
+    return activeEntries().first()->filePath;
 }
 
 bool PixelPerfectIconEngine::isNull()
@@ -343,3 +1405,194 @@ QString PixelPerfectIconEngine::key() const
 {
     return u"PixelPerfectIconEngine"_s;
 }
+
+void PixelPerfectIconEngine::invalidate(const QString& filePath)
+{
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+
+    // Only engines selecting from a changed entry choose their variants again
+    const auto entryChanged = [&r](const PixelPerfectIconEngineEntry* entry) {
+        const auto isEntry = [entry](const PixelPerfectIconEngineEntryPointer& e) {
+            return e.get() == entry;
+        };
+        for (PixelPerfectIconEngine* engine : std::as_const(r.engines)) {
+            if (std::any_of(engine->m_entries.cbegin(),
+                            engine->m_entries.cend(),
+                            isEntry)
+                || std::any_of(engine->m_entriesDark.cbegin(),
+                               engine->m_entriesDark.cend(),
+                               isEntry)) {
+                ++engine->m_variantGeneration;
+            }
+        }
+    };
+
+    // Stale pixmaps are not removed, their file ids simply stop matching
+    if (filePath.isEmpty()) {
+        for (PixelPerfectIconEngine* engine : std::as_const(r.engines))
+            ++engine->m_variantGeneration;
+        r.directories.clear();
+        r.bundles.clear();
+        for (auto it = r.entries.begin(); it != r.entries.end();) {
+            if (const PixelPerfectIconEngineEntryPointer& entry = it->toStrongRef()) {
+                if (entry->bundle)
+                    bindBundle(r, entry.get());
+                refreshEntry(entry.get());
+                ++it;
+            } else {
+                it = r.entries.erase(it);
+            }
+        }
+        return;
+    }
+
+    // Variants may have been added or removed next to the file
+    const QFileInfo info(filePath);
+    const QString& absoluteFilePath = info.absoluteFilePath();
+    r.directories.remove(info.absolutePath());
+
+    // A rebuilt bundle is opened again for every file inside
+    if (r.bundles.remove(absoluteFilePath)) {
+        r.directories.remove(absoluteFilePath);
+        for (auto it = r.entries.cbegin(); it != r.entries.cend(); ++it) {
+            const PixelPerfectIconEngineEntryPointer& entry = it->toStrongRef();
+            if (entry && entry->bundle
+                && entry->bundle->filePath() == absoluteFilePath) {
+                bindBundle(r, entry.get());
+                refreshEntry(entry.get());
+                entryChanged(entry.get());
+            }
+        }
+        return;
+    }
+
+    if (const PixelPerfectIconEngineEntryPointer& entry
+        = r.entries.value(absoluteFilePath).toStrongRef()) {
+        if (refreshEntry(entry.get()))
+            entryChanged(entry.get());
+    } else {
+        r.entries.remove(absoluteFilePath);
+    }
+}
+
+bool PixelPerfectIconEngine::isAsynchronous()
+{
+    return asynchronous;
+}
+
+void PixelPerfectIconEngine::setAsynchronous(bool enabled)
+{
+    asynchronous = enabled;
+}
+
+bool PixelPerfectIconEngine::isDistanceFieldEnabled()
+{
+    return distanceFieldEnabled;
+}
+
+void PixelPerfectIconEngine::setDistanceFieldEnabled(bool enabled)
+{
+    distanceFieldEnabled = enabled;
+    if (!enabled)
+        distanceFields().clear();
+}
+
+bool PixelPerfectIconEngine::isDiskCacheEnabled()
+{
+    return PixelPerfectDiskCache::instance()->isEnabled();
+}
+
+void PixelPerfectIconEngine::setDiskCacheEnabled(bool enabled)
+{
+    PixelPerfectDiskCache::instance()->setEnabled(enabled);
+}
+
+int PixelPerfectIconEngine::cacheBudget()
+{
+    return PixelPerfectIconAtlas::instance()->budget() + int(pixmapCache().maxCost());
+}
+
+// Split evenly between the atlas and the pixmaps of scaledPixmap()
+void PixelPerfectIconEngine::setCacheBudget(int kilobytes)
+{
+    const int budget = qMax(0, kilobytes);
+    PixelPerfectIconAtlas::instance()->setBudget(budget / 2);
+
+    const qsizetype size = pixmapCache().size();
+    pixmapCache().setMaxCost(budget - budget / 2);
+    pixmapStatistics.evictions += size - pixmapCache().size();
+}
+
+PixelPerfectIconEngineCacheStatistics PixelPerfectIconEngine::cacheStatistics()
+{
+    const PixelPerfectIconAtlas* atlas = PixelPerfectIconAtlas::instance();
+    return PixelPerfectIconEngineCacheStatistics{
+        .hits = pixmapStatistics.hits,
+        .misses = pixmapStatistics.misses,
+        .evictions = pixmapStatistics.evictions + atlas->evictions(),
+        .cost = atlas->cost() + pixmapCache().totalCost(),
+        .count = atlas->count() + pixmapCache().size()};
+}
+
+void PixelPerfectIconEngine::resetCacheStatistics()
+{
+    pixmapStatistics.hits = 0;
+    pixmapStatistics.misses = 0;
+    pixmapStatistics.evictions = 0;
+    PixelPerfectIconAtlas::instance()->resetEvictions();
+}
+
+void PixelPerfectIconEngine::clearCache()
+{
+    PixelPerfectIconAtlas::instance()->clear();
+    pixmapCache().clear();
+    distanceFields().clear();
+    nullRasters().clear();
+}
+
+bool PixelPerfectIconEngine::isFileWatcherEnabled()
+{
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    return r.watcher;
+}
+
+void PixelPerfectIconEngine::setFileWatcherEnabled(bool enabled)
+{
+    PixelPerfectIconEngineRegistry& r = registry();
+    QMutexLocker locker(&r.mutex);
+
+    if (enabled == !r.watcher.isNull())
+        return;
+
+    if (!enabled) {
+        delete r.watcher;
+        return;
+    }
+
+    r.watcher = new QFileSystemWatcher(qApp);
+    QObject::connect(r.watcher,
+                     &QFileSystemWatcher::fileChanged,
+                     [](const QString& path) {
+                         invalidate(path);
+
+                         // Files replaced rather than rewritten lose their watch
+                         PixelPerfectIconEngineRegistry& r = registry();
+                         QMutexLocker locker(&r.mutex);
+                         if (r.watcher && r.entries.contains(path)
+                             && QFileInfo::exists(path)
+                             && !r.watcher->files().contains(path)) {
+                             r.watcher->addPath(path);
+                         }
+                     });
+
+    QStringList filePaths;
+    for (auto it = r.entries.cbegin(); it != r.entries.cend(); ++it) {
+        const PixelPerfectIconEngineEntryPointer& entry = it->toStrongRef();
+        if (entry && !entry->bundle)
+            filePaths.append(it.key());
+    }
+    if (!filePaths.isEmpty())
+        r.watcher->addPaths(filePaths);
+}
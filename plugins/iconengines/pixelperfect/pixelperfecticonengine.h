@@ -3,30 +3,119 @@
 
 #pragma once
 
+#include <QDateTime>
+#include <QHash>
 #include <QIconEngine>
 #include <QMap>
+#include <QPointer>
+#include <QSharedPointer>
 
+#include <atomic>
+#include <functional>
+
+class PixelPerfectIconBundle;
+struct PixelPerfectIconAtlasSlot;
+
+// Entries are shared by every engine using the same file, the size and the
+// file identity are captured once and refreshed only on invalidation, under the
+// registry mutex. The file id changes whenever the file does, so pixmaps of
+// older contents stop matching
 struct PixelPerfectIconEngineEntry
 {
     QSize size;
     QString filePath;
+    QDateTime lastModified;
+    qint64 fileSize;
+    quint64 fileId;
+    quint64 fileHash; // Same across processes, unlike the file id
+    QSharedPointer<PixelPerfectIconBundle> bundle; // Null for plain files
+    int bundleIndex;
 };
 Q_DECLARE_TYPEINFO(PixelPerfectIconEngineEntry, Q_RELOCATABLE_TYPE);
 
-using PixelPerfectIconEngineEntryMap = QMap<int, PixelPerfectIconEngineEntry>;
+struct PixelPerfectPixmapKey
+{
+    quint64 fileId;
+    int width;
+    int height;
+    quint16 devicePixelRatio; // In thousandths
+    quint8 mode;
+    quint8 state;
+    QRgb tint; // Zero when untinted
+    QRgb highlight; // Of the palette for selected icons, zero for the others
+
+    friend bool operator==(const PixelPerfectPixmapKey&,
+                           const PixelPerfectPixmapKey&) = default;
+};
+Q_DECLARE_TYPEINFO(PixelPerfectPixmapKey, Q_PRIMITIVE_TYPE);
+
+inline size_t qHash(const PixelPerfectPixmapKey& key, size_t seed = 0) noexcept
+{
+    return qHashMulti(seed,
+                      key.fileId,
+                      key.width,
+                      key.height,
+                      key.devicePixelRatio,
+                      key.mode,
+                      key.state,
+                      key.tint,
+                      key.highlight);
+}
+
+using PixelPerfectIconEngineEntryPointer = QSharedPointer<PixelPerfectIconEngineEntry>;
+using PixelPerfectIconEngineEntryMap = QMap<int, PixelPerfectIconEngineEntryPointer>;
 using PixelPerfectIconEngineEntryMapIterator
-    = QMapIterator<int, PixelPerfectIconEngineEntry>;
+    = QMapIterator<int, PixelPerfectIconEngineEntryPointer>;
+
+struct PixelPerfectIconEngineVariants
+{
+    PixelPerfectIconEngineEntryMap entries;
+    PixelPerfectIconEngineEntryMap entriesDark;
+};
+
+struct PixelPerfectIconEngineCacheStatistics
+{
+    qint64 hits;
+    qint64 misses;
+    qint64 evictions;
+    qsizetype cost; // In kilobytes
+    qsizetype count;
+};
+
+// Which variant to rasterize and by how much for one requested size
+struct PixelPerfectIconEngineSelection
+{
+    PixelPerfectIconEngineEntryPointer match; // A copy, refreshes leave it alone
+    qreal scale;
+    QSize targetSize;
+    quint64 generation;
+};
+
+// A size the engine was painted at, kept to rasterize it again when the color
+// scheme changes
+struct PixelPerfectIconEngineUsage
+{
+    QSize size;
+    qreal devicePixelRatio;
+    QIcon::Mode mode;
+    QIcon::State state;
+    QRgb tint;
+    QPointer<QObject> updateTarget;
+};
 
 class PixelPerfectIconEngine final : public QIconEngine
 {
 public:
     PixelPerfectIconEngine(const QString& filePath);
     PixelPerfectIconEngine(const PixelPerfectIconEngine& other);
+    ~PixelPerfectIconEngine() override;
 
     QString iconName() override;
     QString iconName() const;
     QString key() const override;
     QIconEngine* clone() const override;
+    bool read(QDataStream& in) override;
+    bool write(QDataStream& out) const override;
     bool isNull() const;
     bool isNull() override;
     QPixmap pixmap(const QSize& size, QIcon::Mode mode, QIcon::State state) override;
@@ -38,22 +127,90 @@ public:
                const QRect& rect,
                QIcon::Mode mode,
                QIcon::State state) override;
+    void paintTinted(QPainter* painter,
+                     const QRect& rect,
+                     QIcon::Mode mode,
+                     QIcon::State state,
+                     const QColor& color) const;
+    bool prewarm(const QSize& size,
+                 qreal devicePixelRatio,
+                 QIcon::Mode mode,
+                 QIcon::State state,
+                 const std::function<void()>& done) const;
+
+    static void invalidate(const QString& filePath = QString());
+    static bool isAsynchronous();
+    static void setAsynchronous(bool enabled);
+    static bool isDistanceFieldEnabled();
+    static void setDistanceFieldEnabled(bool enabled);
+    static bool isDiskCacheEnabled();
+    static void setDiskCacheEnabled(bool enabled);
+    static int cacheBudget(); // In kilobytes
+    static void setCacheBudget(int kilobytes);
+    static PixelPerfectIconEngineCacheStatistics cacheStatistics();
+    static void resetCacheStatistics();
+    static void clearCache();
+    static bool isFileWatcherEnabled();
+    static void setFileWatcherEnabled(bool enabled);
 
 private:
     void init(const QString& filePath);
+    void registerEngine();
+    static void updateColorScheme(Qt::ColorScheme colorScheme);
+    void switchColorScheme(bool dark, quint64 generation);
+    void finishColorSchemeSwitch(quint64 generation);
     const PixelPerfectIconEngineEntryMap& activeEntries() const;
-    QString cacheKeyFor(const QString& filePath,
-                        const QSize& size,
-                        qreal devicePixelRatio,
-                        QIcon::Mode mode,
-                        QIcon::State state) const;
-    QPixmap bestMatch(const QSize& size,
+    const PixelPerfectIconEngineEntryMap& activeEntries(bool dark) const;
+    quint64 diskKeyFor(const PixelPerfectIconEngineEntry& entry,
+                       const QSize& size,
+                       qreal devicePixelRatio,
+                       QIcon::Mode mode,
+                       QIcon::State state,
+                       bool dark,
+                       QRgb tint = 0) const;
+    PixelPerfectPixmapKey cacheKeyFor(const PixelPerfectIconEngineEntry& entry,
+                                      const QSize& size,
+                                      qreal devicePixelRatio,
+                                      QIcon::Mode mode,
+                                      QIcon::State state,
+                                      QRgb tint = 0) const;
+    PixelPerfectIconEngineSelection selectVariant(const QSize& size,
+                                                  qreal devicePixelRatio,
+                                                  bool dark) const;
+    bool paintDistanceField(QPainter* painter,
+                            const QRect& rect,
+                            QIcon::Mode mode,
+                            QRgb tint) const;
+    bool deriveRaster(const PixelPerfectIconEngineEntry& entry,
+                      const QSize& targetSize,
+                      qreal devicePixelRatio,
+                      QIcon::Mode mode,
+                      QIcon::State state,
+                      QRgb tint,
+                      QImage* image) const;
+    PixelPerfectIconAtlasSlot bestMatch(const QSize& size,
+                                        qreal devicePixelRatio,
+                                        QIcon::Mode mode,
+                                        QIcon::State state,
+                                        QRgb tint = 0,
+                                        QObject* updateTarget = nullptr) const;
+    bool prerasterize(const QSize& size,
                       qreal devicePixelRatio,
                       QIcon::Mode mode,
-                      QIcon::State state) const;
+                      QIcon::State state,
+                      QRgb tint,
+                      bool dark,
+                      const std::function<void()>& done) const;
     QRect greaterRect(const QSize& size, qreal devicePixelRatio) const;
 
 private:
     PixelPerfectIconEngineEntryMap m_entries;
     PixelPerfectIconEngineEntryMap m_entriesDark;
+    mutable QHash<quint64, PixelPerfectIconEngineSelection> m_selections;
+    std::atomic<quint64> m_variantGeneration; // Bumped when the variants change
+    mutable QList<PixelPerfectIconEngineUsage> m_usages;
+    bool m_dark;
+    bool m_pendingDark;
+    quint64 m_switchGeneration;
+    int m_pendingRasters;
 };
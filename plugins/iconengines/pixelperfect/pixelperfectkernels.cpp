@@ -0,0 +1,408 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "pixelperfectkernels.h"
+
+#include <QtCore/qsimd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+static inline quint32 byteMul(quint32 x, uint a)
+{
+    quint32 t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+static void colorizeLine(quint32* line, int count, quint32 color)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32(int(color)), zero);
+    const __m128i half = _mm_set1_epi16(0x80);
+    for (; x + 4 <= count; x += 4) {
+        auto pixels = reinterpret_cast<__m128i*>(line + x);
+        // Every 16-bit lane of a pixel gets its alpha
+        __m128i alpha = _mm_srli_epi32(_mm_loadu_si128(pixels), 24);
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        __m128i lo = _mm_mullo_epi16(color16, _mm_unpacklo_epi32(alpha, alpha));
+        __m128i hi = _mm_mullo_epi16(color16, _mm_unpackhi_epi32(alpha, alpha));
+        lo = _mm_add_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), half);
+        hi = _mm_add_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), half);
+        lo = _mm_srli_epi16(lo, 8);
+        hi = _mm_srli_epi16(hi, 8);
+        _mm_storeu_si128(pixels, _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x8_t b = vdup_n_u8(qBlue(color));
+    const uint8x8_t g = vdup_n_u8(qGreen(color));
+    const uint8x8_t r = vdup_n_u8(qRed(color));
+    const uint8x8_t a = vdup_n_u8(qAlpha(color));
+    for (; x + 8 <= count; x += 8) {
+        auto pixels = reinterpret_cast<quint8*>(line + x);
+        uint8x8x4_t p = vld4_u8(pixels);
+        const uint8x8_t alpha = p.val[3];
+        const uint16x8_t pb = vmull_u8(b, alpha);
+        const uint16x8_t pg = vmull_u8(g, alpha);
+        const uint16x8_t pr = vmull_u8(r, alpha);
+        const uint16x8_t pa = vmull_u8(a, alpha);
+        p.val[0] = vrshrn_n_u16(vsraq_n_u16(pb, pb, 8), 8);
+        p.val[1] = vrshrn_n_u16(vsraq_n_u16(pg, pg, 8), 8);
+        p.val[2] = vrshrn_n_u16(vsraq_n_u16(pr, pr, 8), 8);
+        p.val[3] = vrshrn_n_u16(vsraq_n_u16(pa, pa, 8), 8);
+        vst4_u8(pixels, p);
+    }
+#endif
+
+    for (; x < count; ++x)
+        line[x] = byteMul(color, line[x] >> 24);
+}
+
+void PixelPerfectKernels::colorize(QImage* image, QRgb color)
+{
+    if (image->format() != QImage::Format_ARGB32_Premultiplied)
+        image->convertTo(QImage::Format_ARGB32_Premultiplied);
+
+    const quint32 premultiplied = qPremultiply(color);
+    for (int y = 0; y < image->height(); ++y) {
+        colorizeLine(reinterpret_cast<quint32*>(image->scanLine(y)),
+                     image->width(),
+                     premultiplied);
+    }
+}
+
+// BT.601 luma weights in 1/256, their sum keeps premultiplied pixels valid
+static constexpr uint redWeight = 77;
+static constexpr uint greenWeight = 150;
+static constexpr uint blueWeight = 29;
+
+static void grayscaleLine(quint32* line, int count, uint opacity)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i red = _mm_set1_epi32(redWeight);
+    const __m128i green = _mm_set1_epi32(greenWeight);
+    const __m128i blue = _mm_set1_epi32(blueWeight);
+    const __m128i fade = _mm_set1_epi32(opacity);
+    for (; x + 4 <= count; x += 4) {
+        auto pixels = reinterpret_cast<__m128i*>(line + x);
+        const __m128i p = _mm_loadu_si128(pixels);
+        // Every channel gets its own 32-bit lane, the products fit into 16 bits
+        const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+        const __m128i b = _mm_and_si128(p, mask);
+        __m128i gray = _mm_mullo_epi16(r, red);
+        gray = _mm_add_epi16(gray, _mm_mullo_epi16(g, green));
+        gray = _mm_srli_epi16(_mm_add_epi16(gray, _mm_mullo_epi16(b, blue)), 8);
+        gray = _mm_srli_epi16(_mm_mullo_epi16(gray, fade), 8);
+        __m128i alpha = _mm_srli_epi32(p, 24);
+        alpha = _mm_srli_epi16(_mm_mullo_epi16(alpha, fade), 8);
+        __m128i result = _mm_or_si128(gray, _mm_slli_epi32(gray, 8));
+        result = _mm_or_si128(result, _mm_slli_epi32(gray, 16));
+        result = _mm_or_si128(result, _mm_slli_epi32(alpha, 24));
+        _mm_storeu_si128(pixels, result);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint16x8_t fade = vdupq_n_u16(opacity);
+    for (; x + 8 <= count; x += 8) {
+        auto pixels = reinterpret_cast<quint8*>(line + x);
+        uint8x8x4_t p = vld4_u8(pixels);
+        uint16x8_t sum = vmull_u8(p.val[2], vdup_n_u8(redWeight));
+        sum = vmlal_u8(sum, p.val[1], vdup_n_u8(greenWeight));
+        sum = vmlal_u8(sum, p.val[0], vdup_n_u8(blueWeight));
+        const uint8x8_t gray = vshrn_n_u16(vmulq_u16(vshrq_n_u16(sum, 8), fade), 8);
+        p.val[0] = gray;
+        p.val[1] = gray;
+        p.val[2] = gray;
+        p.val[3] = vshrn_n_u16(vmulq_u16(vmovl_u8(p.val[3]), fade), 8);
+        vst4_u8(pixels, p);
+    }
+#endif
+
+    for (; x < count; ++x) {
+        const quint32 p = line[x];
+        uint gray = ((p >> 16) & 0xff) * redWeight + ((p >> 8) & 0xff) * greenWeight
+                    + (p & 0xff) * blueWeight;
+        gray = ((gray >> 8) * opacity) >> 8;
+        const uint alpha = ((p >> 24) * opacity) >> 8;
+        line[x] = (alpha << 24) | (gray << 16) | (gray << 8) | gray;
+    }
+}
+
+void PixelPerfectKernels::grayscale(QImage* image, int opacity)
+{
+    if (image->format() != QImage::Format_ARGB32_Premultiplied)
+        image->convertTo(QImage::Format_ARGB32_Premultiplied);
+
+    for (int y = 0; y < image->height(); ++y) {
+        grayscaleLine(reinterpret_cast<quint32*>(image->scanLine(y)),
+                      image->width(),
+                      uint(qBound(0, opacity, 256)));
+    }
+}
+
+static inline quint32 interpolate(quint32 x, uint a, quint32 y, uint b)
+{
+    quint32 t = (x & 0xff00ff) * a + (y & 0xff00ff) * b;
+    t = (t >> 8) & 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a + ((y >> 8) & 0xff00ff) * b;
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+static void highlightLine(quint32* line, int count, quint32 color, uint strength)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32(int(color)), zero);
+    const __m128i half = _mm_set1_epi16(0x80);
+    const __m128i keep = _mm_set1_epi16(short(256 - strength));
+    const __m128i mix = _mm_set1_epi16(short(strength));
+    for (; x + 4 <= count; x += 4) {
+        auto pixels = reinterpret_cast<__m128i*>(line + x);
+        const __m128i p = _mm_loadu_si128(pixels);
+        // The color at the alpha of every pixel, same as colorizeLine()
+        __m128i alpha = _mm_srli_epi32(p, 24);
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        __m128i lo = _mm_mullo_epi16(color16, _mm_unpacklo_epi32(alpha, alpha));
+        __m128i hi = _mm_mullo_epi16(color16, _mm_unpackhi_epi32(alpha, alpha));
+        lo = _mm_add_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), half);
+        hi = _mm_add_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), half);
+        lo = _mm_mullo_epi16(_mm_srli_epi16(lo, 8), mix);
+        hi = _mm_mullo_epi16(_mm_srli_epi16(hi, 8), mix);
+        lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), keep));
+        hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), keep));
+        lo = _mm_srli_epi16(lo, 8);
+        hi = _mm_srli_epi16(hi, 8);
+        _mm_storeu_si128(pixels, _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x8_t c[4] = {vdup_n_u8(qBlue(color)),
+                            vdup_n_u8(qGreen(color)),
+                            vdup_n_u8(qRed(color)),
+                            vdup_n_u8(qAlpha(color))};
+    const uint8x8_t keep = vdup_n_u8(256 - strength);
+    const uint8x8_t mix = vdup_n_u8(strength);
+    for (; x + 8 <= count; x += 8) {
+        auto pixels = reinterpret_cast<quint8*>(line + x);
+        uint8x8x4_t p = vld4_u8(pixels);
+        const uint8x8_t alpha = p.val[3];
+        for (int i = 0; i < 4; ++i) {
+            const uint16x8_t t = vmull_u8(c[i], alpha);
+            const uint8x8_t tinted = vrshrn_n_u16(vsraq_n_u16(t, t, 8), 8);
+            const uint16x8_t sum = vmlal_u8(vmull_u8(p.val[i], keep), tinted, mix);
+            p.val[i] = vshrn_n_u16(sum, 8);
+        }
+        vst4_u8(pixels, p);
+    }
+#endif
+
+    for (; x < count; ++x) {
+        const quint32 tinted = byteMul(color, line[x] >> 24);
+        line[x] = interpolate(line[x], 256 - strength, tinted, strength);
+    }
+}
+
+void PixelPerfectKernels::highlight(QImage* image, QRgb color, int strength)
+{
+    // Keeps both weights within a byte for the line
+    if (strength <= 0)
+        return;
+    if (strength >= 256) {
+        colorize(image, color);
+        return;
+    }
+
+    if (image->format() != QImage::Format_ARGB32_Premultiplied)
+        image->convertTo(QImage::Format_ARGB32_Premultiplied);
+
+    const quint32 premultiplied = qPremultiply(color);
+    for (int y = 0; y < image->height(); ++y) {
+        highlightLine(reinterpret_cast<quint32*>(image->scanLine(y)),
+                      image->width(),
+                      premultiplied,
+                      uint(strength));
+    }
+}
+
+template<int Factor>
+static void upscaleLine(const quint32* src, quint32* dst, int count)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    for (; x + 4 <= count; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        auto out = reinterpret_cast<__m128i*>(dst + x * Factor);
+        if constexpr (Factor == 2) {
+            _mm_storeu_si128(out, _mm_unpacklo_epi32(p, p));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(p, p));
+        } else if constexpr (Factor == 3) {
+            _mm_storeu_si128(out, _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 0, 0)));
+            _mm_storeu_si128(out + 1, _mm_shuffle_epi32(p, _MM_SHUFFLE(2, 2, 1, 1)));
+            _mm_storeu_si128(out + 2, _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 2)));
+        } else {
+            _mm_storeu_si128(out, _mm_shuffle_epi32(p, _MM_SHUFFLE(0, 0, 0, 0)));
+            _mm_storeu_si128(out + 1, _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 1, 1, 1)));
+            _mm_storeu_si128(out + 2, _mm_shuffle_epi32(p, _MM_SHUFFLE(2, 2, 2, 2)));
+            _mm_storeu_si128(out + 3, _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // Interleaving stores of the same register repeat each lane
+    for (; x + 4 <= count; x += 4) {
+        const uint32x4_t p = vld1q_u32(src + x);
+        if constexpr (Factor == 2)
+            vst2q_u32(dst + x * Factor, (uint32x4x2_t{{p, p}}));
+        else if constexpr (Factor == 3)
+            vst3q_u32(dst + x * Factor, (uint32x4x3_t{{p, p, p}}));
+        else
+            vst4q_u32(dst + x * Factor, (uint32x4x4_t{{p, p, p, p}}));
+    }
+#endif
+
+    for (; x < count; ++x) {
+        for (int i = 0; i < Factor; ++i)
+            dst[x * Factor + i] = src[x];
+    }
+}
+
+static void upscaleLine(const quint32* src, quint32* dst, int count, int factor)
+{
+    switch (factor) {
+    case 2:
+        upscaleLine<2>(src, dst, count);
+        break;
+    case 3:
+        upscaleLine<3>(src, dst, count);
+        break;
+    case 4:
+        upscaleLine<4>(src, dst, count);
+        break;
+    default:
+        for (int x = 0; x < count; ++x)
+            std::fill_n(dst + x * factor, factor, src[x]);
+        break;
+    }
+}
+
+QImage PixelPerfectKernels::upscale(const QImage& image, int factor)
+{
+    if (image.isNull() || factor <= 1)
+        return image;
+
+    const QImage& source = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage result(source.size() * factor, QImage::Format_ARGB32_Premultiplied);
+    if (result.isNull())
+        return result;
+
+    const qsizetype lineSize = qsizetype(result.width()) * sizeof(quint32);
+    for (int y = 0; y < source.height(); ++y) {
+        auto first = reinterpret_cast<quint32*>(result.scanLine(y * factor));
+        upscaleLine(reinterpret_cast<const quint32*>(source.constScanLine(y)),
+                    first,
+                    source.width(),
+                    factor);
+        for (int i = 1; i < factor; ++i)
+            memcpy(result.scanLine(y * factor + i), first, lineSize);
+    }
+    result.setDevicePixelRatio(image.devicePixelRatio());
+    return result;
+}
+
+static void halveLine(const quint32* line0,
+                      const quint32* line1,
+                      quint32* dst,
+                      int width)
+{
+    const int count = qMax(1, width / 2);
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; (x + 2) * 2 <= width; x += 2) {
+        const __m128i a = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(line0 + x * 2));
+        const __m128i b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(line1 + x * 2));
+        // Vertical sums of source pixels 0 and 1, then of 2 and 3
+        const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                         _mm_unpacklo_epi8(b, zero));
+        const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                         _mm_unpackhi_epi8(b, zero));
+        __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                                    _mm_unpackhi_epi64(lo, hi));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x),
+                         _mm_packus_epi16(sum, sum));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; (x + 2) * 2 <= width; x += 2) {
+        const uint8x16_t a = vld1q_u8(
+            reinterpret_cast<const quint8*>(line0 + x * 2));
+        const uint8x16_t b = vld1q_u8(
+            reinterpret_cast<const quint8*>(line1 + x * 2));
+        const uint16x8_t lo = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+        const uint16x8_t hi = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+        const uint16x8_t sum = vaddq_u16(
+            vcombine_u16(vget_low_u16(lo), vget_low_u16(hi)),
+            vcombine_u16(vget_high_u16(lo), vget_high_u16(hi)));
+        vst1_u8(reinterpret_cast<quint8*>(dst + x), vrshrn_n_u16(sum, 2));
+    }
+#endif
+
+    for (; x < count; ++x) {
+        const int x0 = qMin(x * 2, width - 1);
+        const int x1 = qMin(x * 2 + 1, width - 1);
+        const quint32 pixels[] = {line0[x0], line0[x1], line1[x0], line1[x1]};
+        quint32 result = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint sum = 2;
+            for (quint32 pixel : pixels)
+                sum += (pixel >> shift) & 0xff;
+            result |= (sum >> 2) << shift;
+        }
+        dst[x] = result;
+    }
+}
+
+QImage PixelPerfectKernels::halve(const QImage& image)
+{
+    if (image.isNull())
+        return image;
+
+    const QImage& source = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage result(qMax(1, source.width() / 2),
+                  qMax(1, source.height() / 2),
+                  QImage::Format_ARGB32_Premultiplied);
+    if (result.isNull())
+        return result;
+
+    for (int y = 0; y < result.height(); ++y) {
+        const int y0 = qMin(y * 2, source.height() - 1);
+        const int y1 = qMin(y * 2 + 1, source.height() - 1);
+        halveLine(reinterpret_cast<const quint32*>(source.constScanLine(y0)),
+                  reinterpret_cast<const quint32*>(source.constScanLine(y1)),
+                  reinterpret_cast<quint32*>(result.scanLine(y)),
+                  source.width());
+    }
+    return result;
+}
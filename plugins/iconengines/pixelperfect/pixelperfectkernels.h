@@ -0,0 +1,29 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QImage>
+
+namespace PixelPerfectKernels {
+
+// Replaces the colors with the given one and keeps the alpha, same as filling
+// with QPainter::CompositionMode_SourceIn
+void colorize(QImage* image, QRgb color);
+
+// Turns the colors into their luminance and scales the result by the given
+// opacity, from 0 to 256
+void grayscale(QImage* image, int opacity);
+
+// Moves the colors towards the given one by the given strength, from 0 to
+// 256, same as filling with QPainter::CompositionMode_SourceAtop
+void highlight(QImage* image, QRgb color, int strength);
+
+// Repeats every pixel factor times in both directions, nothing is blended
+QImage upscale(const QImage& image, int factor);
+
+// Averages every 2x2 block of premultiplied pixels. The last column or row of
+// odd sizes is dropped, a single one is repeated
+QImage halve(const QImage& image);
+
+} // namespace PixelPerfectKernels
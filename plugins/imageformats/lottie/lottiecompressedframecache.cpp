@@ -0,0 +1,174 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "lottiecompressedframecache.h"
+
+#include <QtCore/qsimd.h>
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static constexpr int tileSize = 16;
+static constexpr int keyframeInterval = 16;
+
+static QRect tileRect(int index, const QSize& size)
+{
+    const int tilesPerRow = (size.width() + tileSize - 1) / tileSize;
+    const QRect tile((index % tilesPerRow) * tileSize,
+                     (index / tilesPerRow) * tileSize,
+                     tileSize,
+                     tileSize);
+    return tile & QRect(QPoint(), size);
+}
+
+static int tileCount(const QSize& size)
+{
+    return ((size.width() + tileSize - 1) / tileSize)
+           * ((size.height() + tileSize - 1) / tileSize);
+}
+
+static bool isTransparent(const QImage& image, const QRect& tile)
+{
+    for (int y = tile.top(); y <= tile.bottom(); ++y) {
+        auto line = reinterpret_cast<const quint32*>(image.constScanLine(y)) + tile.x();
+        int x = 0;
+#if defined(__SSE2__)
+        __m128i bits = _mm_setzero_si128();
+        for (; x + 4 <= tile.width(); x += 4) {
+            bits = _mm_or_si128(bits,
+                                _mm_loadu_si128(
+                                    reinterpret_cast<const __m128i*>(line + x)));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(bits, _mm_setzero_si128())) != 0xffff)
+            return false;
+#endif
+        for (; x < tile.width(); ++x) {
+            if (line[x])
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool isUnchanged(const QImage& image, const QImage& reference, const QRect& tile)
+{
+    const size_t rowSize = tile.width() * sizeof(quint32);
+    const qsizetype offset = tile.x() * sizeof(quint32);
+    for (int y = tile.top(); y <= tile.bottom(); ++y) {
+        if (std::memcmp(image.constScanLine(y) + offset,
+                        reference.constScanLine(y) + offset,
+                        rowSize)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LottieCompressedFrameCache::LottieCompressedFrameCache(qsizetype maxCost)
+    : m_frames(maxCost)
+{}
+
+void LottieCompressedFrameCache::clear()
+{
+    m_frames.clear();
+    m_reference = QImage();
+    m_referenceFrame = -1;
+}
+
+bool LottieCompressedFrameCache::read(int frameNumber, QImage* image)
+{
+    if (!m_frames.contains(frameNumber))
+        return false;
+
+    if (frameNumber == m_referenceFrame) {
+        *image = m_reference;
+        return true;
+    }
+
+    // Walk back to a keyframe, or to the frame we decoded or stored last
+    int first = frameNumber;
+    for (const Frame* frame = m_frames.object(first);
+         !frame->keyframe && first - 1 != m_referenceFrame;) {
+        frame = m_frames.object(--first);
+        if (!frame) {
+            // Evicted in between, storing the frame again makes it a keyframe
+            m_frames.remove(frameNumber);
+            return false;
+        }
+    }
+
+    for (int number = first; number <= frameNumber; ++number) {
+        decode(*m_frames.object(number));
+        m_referenceFrame = number;
+    }
+
+    *image = m_reference;
+    return true;
+}
+
+void LottieCompressedFrameCache::insert(int frameNumber, const QImage& image)
+{
+    if (m_frames.contains(frameNumber))
+        return;
+
+    const QSize& size = image.size();
+    const bool delta = frameNumber % keyframeInterval != 0
+                       && frameNumber - 1 == m_referenceFrame
+                       && m_reference.size() == size;
+
+    auto frame = new Frame{.keyframe = !delta, .size = size};
+    frame->tiles.resize(tileCount(size));
+    for (int i = 0; i < frame->tiles.size(); ++i) {
+        const QRect& tile = tileRect(i, size);
+        if (isTransparent(image, tile)) {
+            frame->tiles[i] = Transparent;
+        } else if (delta && isUnchanged(image, m_reference, tile)) {
+            frame->tiles[i] = Unchanged;
+        } else {
+            frame->tiles[i] = Raw;
+            const qsizetype rowSize = tile.width() * sizeof(quint32);
+            for (int y = tile.top(); y <= tile.bottom(); ++y) {
+                frame->pixels.append(reinterpret_cast<const char*>(
+                                         image.constScanLine(y) + tile.x() * 4),
+                                     rowSize);
+            }
+        }
+    }
+
+    m_reference = image;
+    m_referenceFrame = frameNumber;
+
+    const qsizetype cost = frame->tiles.size() + frame->pixels.size();
+    m_frames.insert(frameNumber, frame, qMax(1, int(cost / 1024)));
+}
+
+void LottieCompressedFrameCache::decode(const Frame& frame)
+{
+    if (m_reference.size() != frame.size)
+        m_reference = QImage(frame.size, QImage::Format_ARGB32_Premultiplied);
+
+    // Plain row copies and clears, both are vectorized by the C library
+    uchar* bits = m_reference.bits();
+    const qsizetype bytesPerLine = m_reference.bytesPerLine();
+    const char* pixels = frame.pixels.constData();
+    for (int i = 0; i < frame.tiles.size(); ++i) {
+        const Tile kind = Tile(frame.tiles[i]);
+        if (kind == Unchanged)
+            continue;
+
+        const QRect& tile = tileRect(i, frame.size);
+        const size_t rowSize = tile.width() * sizeof(quint32);
+        for (int y = tile.top(); y <= tile.bottom(); ++y) {
+            uchar* line = bits + y * bytesPerLine + tile.x() * sizeof(quint32);
+            if (kind == Transparent) {
+                std::memset(line, 0, rowSize);
+            } else {
+                std::memcpy(line, pixels, rowSize);
+                pixels += rowSize;
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QByteArray>
+#include <QCache>
+#include <QImage>
+
+/*
+ * Keeps rendered frames as 16x16 tiles that are either fully transparent,
+ * unchanged since the previous frame or stored raw. Every 16th frame is a
+ * keyframe without unchanged tiles, so that seeking never has to walk far.
+*/
+
+class LottieCompressedFrameCache final
+{
+    Q_DISABLE_COPY(LottieCompressedFrameCache)
+
+public:
+    explicit LottieCompressedFrameCache(qsizetype maxCost);
+
+    void clear();
+    bool read(int frameNumber, QImage* image);
+    void insert(int frameNumber, const QImage& image);
+
+private:
+    enum Tile : quint8 { Transparent, Unchanged, Raw };
+
+    struct Frame
+    {
+        bool keyframe;
+        QSize size;
+        QByteArray tiles;
+        QByteArray pixels;
+    };
+
+    void decode(const Frame& frame);
+
+    QCache<int, Frame> m_frames;
+    QImage m_reference;
+    int m_referenceFrame = -1;
+};
@@ -0,0 +1,423 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "lottiedisplaylist.h"
+#include "lottiescanlinerasterizer.h"
+
+#include <QPaintEngine>
+#include <QPainter>
+#include <QPainterPath>
+
+#include <cstring>
+#include <utility>
+
+// Curves are flattened at this multiple of the canvas resolution so that
+// replaying at higher scales (i.e., after a DPI change) does not show facets
+static constexpr qreal flatteningScale = 4.0;
+
+template <typename T>
+static T read(const char** data)
+{
+    T value;
+    std::memcpy(&value, *data, sizeof(T));
+    *data += sizeof(T);
+    return value;
+}
+
+static QPainterPath readPath(const char** data, Qt::FillRule fillRule)
+{
+    QPainterPath path;
+    path.setFillRule(fillRule);
+    const quint32 polygonCount = read<quint32>(data);
+    for (quint32 i = 0; i < polygonCount; ++i) {
+        const quint32 pointCount = read<quint32>(data);
+        for (quint32 j = 0; j < pointCount; ++j) {
+            const float x = read<float>(data);
+            const float y = read<float>(data);
+            if (j == 0)
+                path.moveTo(x, y);
+            else
+                path.lineTo(x, y);
+        }
+        path.closeSubpath();
+    }
+    return path;
+}
+
+static QRectF readRect(const char** data)
+{
+    const float x = read<float>(data);
+    const float y = read<float>(data);
+    const float w = read<float>(data);
+    const float h = read<float>(data);
+    return QRectF(x, y, w, h);
+}
+
+static QTransform readTransform(const char** data)
+{
+    const float m11 = read<float>(data);
+    const float m12 = read<float>(data);
+    const float m21 = read<float>(data);
+    const float m22 = read<float>(data);
+    const float dx = read<float>(data);
+    const float dy = read<float>(data);
+    return QTransform(m11, m12, m21, m22, dx, dy);
+}
+
+class LottieDisplayListPaintEngine final : public QPaintEngine
+{
+public:
+    explicit LottieDisplayListPaintEngine(LottieDisplayList* displayList);
+
+    bool begin(QPaintDevice* device) override;
+    bool end() override;
+    Type type() const override;
+
+    void updateState(const QPaintEngineState& state) override;
+    void drawPath(const QPainterPath& path) override;
+    void drawPolygon(const QPointF* points,
+                     int pointCount,
+                     PolygonDrawMode mode) override;
+    void drawPixmap(const QRectF& r, const QPixmap& pm, const QRectF& sr) override;
+    void drawImage(const QRectF& r,
+                   const QImage& image,
+                   const QRectF& sr,
+                   Qt::ImageConversionFlags flags) override;
+
+private:
+    template <typename T>
+    void write(T value)
+    {
+        m_displayList->m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writePolygons(const QList<QPolygonF>& polygons);
+    void writeRect(const QRectF& rect);
+    void writeTransform(const QTransform& transform);
+    void applyClip(Qt::ClipOperation operation, const QPainterPath& path);
+    void flushClip();
+    void fill(const QPainterPath& path,
+              const QTransform& transform,
+              const QBrush& brush);
+
+    LottieDisplayList* m_displayList;
+    QTransform m_transform;
+    QBrush m_brush;
+    QPen m_pen;
+    qreal m_opacity = 1.0;
+    QPainterPath m_clipPath;
+    bool m_hasClip = false;
+    bool m_clipEnabled = false;
+    bool m_clipDirty = false;
+};
+
+LottieDisplayListPaintEngine::LottieDisplayListPaintEngine(
+    LottieDisplayList* displayList)
+    : QPaintEngine(QPaintEngine::AllFeatures)
+    , m_displayList(displayList)
+{}
+
+bool LottieDisplayListPaintEngine::begin(QPaintDevice*)
+{
+    return true;
+}
+
+bool LottieDisplayListPaintEngine::end()
+{
+    return true;
+}
+
+QPaintEngine::Type LottieDisplayListPaintEngine::type() const
+{
+    return QPaintEngine::User;
+}
+
+void LottieDisplayListPaintEngine::updateState(const QPaintEngineState& state)
+{
+    const QPaintEngine::DirtyFlags flags = state.state();
+
+    // The transform goes first, clip paths are given in its coordinates
+    if (flags & DirtyTransform)
+        m_transform = state.transform();
+    if (flags & DirtyBrush)
+        m_brush = state.brush();
+    if (flags & DirtyPen)
+        m_pen = state.pen();
+    if (flags & DirtyOpacity)
+        m_opacity = state.opacity();
+    if (flags & DirtyClipPath)
+        applyClip(state.clipOperation(), m_transform.map(state.clipPath()));
+    if (flags & DirtyClipRegion) {
+        QPainterPath path;
+        path.addRegion(state.clipRegion());
+        applyClip(state.clipOperation(), m_transform.map(path));
+    }
+    if (flags & DirtyClipEnabled) {
+        m_clipEnabled = state.isClipEnabled();
+        m_clipDirty = true;
+    }
+}
+
+void LottieDisplayListPaintEngine::drawPath(const QPainterPath& path)
+{
+    if (m_brush.style() != Qt::NoBrush)
+        fill(path, m_transform, m_brush);
+
+    if (m_pen.style() != Qt::NoPen && m_pen.brush().style() != Qt::NoBrush) {
+        // Strokes are baked into fills so that replays never depend on pens
+        QPainterPathStroker stroker(m_pen);
+        if (m_pen.isCosmetic()) {
+            fill(stroker.createStroke(m_transform.map(path)),
+                 QTransform(),
+                 m_pen.brush());
+        } else {
+            fill(stroker.createStroke(path), m_transform, m_pen.brush());
+        }
+    }
+}
+
+void LottieDisplayListPaintEngine::drawPolygon(const QPointF* points,
+                                               int pointCount,
+                                               PolygonDrawMode mode)
+{
+    QPainterPath path;
+    path.addPolygon(QPolygonF(QList<QPointF>(points, points + pointCount)));
+    if (mode == PolylineMode) {
+        const QBrush brush = std::exchange(m_brush, QBrush());
+        drawPath(path);
+        m_brush = brush;
+        return;
+    }
+    path.closeSubpath();
+    path.setFillRule(mode == WindingMode ? Qt::WindingFill : Qt::OddEvenFill);
+    drawPath(path);
+}
+
+void LottieDisplayListPaintEngine::drawPixmap(const QRectF& r,
+                                              const QPixmap& pm,
+                                              const QRectF& sr)
+{
+    drawImage(r, pm.toImage(), sr, Qt::AutoColor);
+}
+
+void LottieDisplayListPaintEngine::drawImage(const QRectF& r,
+                                             const QImage& image,
+                                             const QRectF& sr,
+                                             Qt::ImageConversionFlags)
+{
+    flushClip();
+    write<quint8>(LottieDisplayList::DrawImage);
+    write<quint32>(m_displayList->m_images.size());
+    m_displayList->m_images.append(image);
+    writeTransform(m_transform);
+    writeRect(r);
+    writeRect(sr);
+    write<float>(m_opacity);
+}
+
+void LottieDisplayListPaintEngine::writePolygons(const QList<QPolygonF>& polygons)
+{
+    quint32 polygonCount = 0;
+    for (const QPolygonF& polygon : polygons) {
+        if (polygon.size() > 2)
+            ++polygonCount;
+    }
+
+    write<quint32>(polygonCount);
+    for (const QPolygonF& polygon : polygons) {
+        if (polygon.size() < 3)
+            continue;
+        write<quint32>(polygon.size());
+        for (const QPointF& point : polygon) {
+            write<float>(point.x() / flatteningScale);
+            write<float>(point.y() / flatteningScale);
+        }
+    }
+}
+
+void LottieDisplayListPaintEngine::writeRect(const QRectF& rect)
+{
+    write<float>(rect.x());
+    write<float>(rect.y());
+    write<float>(rect.width());
+    write<float>(rect.height());
+}
+
+void LottieDisplayListPaintEngine::writeTransform(const QTransform& transform)
+{
+    write<float>(transform.m11());
+    write<float>(transform.m12());
+    write<float>(transform.m21());
+    write<float>(transform.m22());
+    write<float>(transform.dx());
+    write<float>(transform.dy());
+}
+
+void LottieDisplayListPaintEngine::applyClip(Qt::ClipOperation operation,
+                                             const QPainterPath& path)
+{
+    if (operation == Qt::NoClip) {
+        m_clipPath = QPainterPath();
+        m_hasClip = false;
+    } else if (operation == Qt::IntersectClip && m_hasClip) {
+        m_clipPath = m_clipPath.intersected(path);
+    } else {
+        m_clipPath = path;
+        m_hasClip = true;
+    }
+    m_clipDirty = true;
+}
+
+void LottieDisplayListPaintEngine::flushClip()
+{
+    if (!m_clipDirty)
+        return;
+
+    if (m_clipEnabled && m_hasClip) {
+        write<quint8>(LottieDisplayList::SetClip);
+        write<quint8>(m_clipPath.fillRule());
+        writePolygons(m_clipPath.toSubpathPolygons(
+            QTransform::fromScale(flatteningScale, flatteningScale)));
+    } else {
+        write<quint8>(LottieDisplayList::ClearClip);
+    }
+
+    m_clipDirty = false;
+}
+
+void LottieDisplayListPaintEngine::fill(const QPainterPath& path,
+                                        const QTransform& transform,
+                                        const QBrush& brush)
+{
+    const QList<QPolygonF>& polygons = path.toSubpathPolygons(
+        transform * QTransform::fromScale(flatteningScale, flatteningScale));
+    if (polygons.isEmpty())
+        return;
+
+    flushClip();
+
+    if (brush.style() == Qt::SolidPattern) {
+        write<quint8>(LottieDisplayList::FillSolid);
+        write<quint8>(path.fillRule());
+        write<quint32>(brush.color().rgba());
+    } else {
+        // Gradients and patterns keep their own geometry, so they carry the
+        // transform along instead of being flattened
+        QBrush canvasBrush(brush);
+        canvasBrush.setTransform(brush.transform() * m_transform);
+        write<quint8>(LottieDisplayList::FillBrush);
+        write<quint8>(path.fillRule());
+        write<quint32>(m_displayList->m_brushes.size());
+        m_displayList->m_brushes.append(canvasBrush);
+    }
+
+    write<float>(m_opacity);
+    writePolygons(polygons);
+}
+
+bool LottieDisplayList::isEmpty() const
+{
+    return m_data.isEmpty();
+}
+
+qsizetype LottieDisplayList::byteSize() const
+{
+    qsizetype size = m_data.size() + m_brushes.size() * qsizetype(sizeof(QBrush));
+    for (const QImage& image : m_images)
+        size += image.sizeInBytes();
+    return size;
+}
+
+void LottieDisplayList::replay(QPainter* painter,
+                               LottieScanlineRasterizer* rasterizer) const
+{
+    painter->save();
+    painter->setPen(Qt::NoPen);
+
+    const qreal opacity = painter->opacity();
+    const char* data = m_data.constData();
+    const char* const end = data + m_data.size();
+
+    while (data < end) {
+        const auto op = Op(read<quint8>(&data));
+        switch (op) {
+        case SetClip: {
+            const auto fillRule = Qt::FillRule(read<quint8>(&data));
+            painter->setClipPath(readPath(&data, fillRule));
+            break;
+        }
+        case ClearClip:
+            painter->setClipping(false);
+            break;
+        case FillSolid:
+        case FillBrush: {
+            const auto fillRule = Qt::FillRule(read<quint8>(&data));
+            if (op == FillSolid)
+                painter->setBrush(QColor::fromRgba(read<quint32>(&data)));
+            else
+                painter->setBrush(m_brushes.at(read<quint32>(&data)));
+            painter->setOpacity(opacity * read<float>(&data));
+            const QPainterPath& path = readPath(&data, fillRule);
+            if (!rasterizer || !rasterizer->drawPath(painter, path))
+                painter->drawPath(path);
+            break;
+        }
+        case DrawImage: {
+            const QImage& image = m_images.at(read<quint32>(&data));
+            const QTransform& transform = readTransform(&data);
+            const QRectF& target = readRect(&data);
+            const QRectF& source = readRect(&data);
+            const float imageOpacity = read<float>(&data);
+            painter->save();
+            painter->setTransform(transform, true);
+            painter->setOpacity(opacity * imageOpacity);
+            painter->drawImage(target, image, source);
+            painter->restore();
+            break;
+        }
+        }
+    }
+
+    painter->restore();
+}
+
+LottieDisplayListRecorder::LottieDisplayListRecorder(LottieDisplayList* displayList,
+                                                     const QSize& size)
+    : QPaintDevice()
+    , m_size(size)
+    , m_engine(std::make_unique<LottieDisplayListPaintEngine>(displayList))
+{}
+
+LottieDisplayListRecorder::~LottieDisplayListRecorder() = default;
+
+QPaintEngine* LottieDisplayListRecorder::paintEngine() const
+{
+    return m_engine.get();
+}
+
+int LottieDisplayListRecorder::metric(PaintDeviceMetric metric) const
+{
+    switch (metric) {
+    case PdmWidth:
+        return m_size.width();
+    case PdmHeight:
+        return m_size.height();
+    case PdmWidthMM:
+        return qRound(m_size.width() * 25.4 / 96.0);
+    case PdmHeightMM:
+        return qRound(m_size.height() * 25.4 / 96.0);
+    case PdmDepth:
+        return 32;
+    case PdmDpiX:
+    case PdmDpiY:
+    case PdmPhysicalDpiX:
+    case PdmPhysicalDpiY:
+        return 96;
+    case PdmDevicePixelRatio:
+        return 1;
+    case PdmDevicePixelRatioScaled:
+        return int(QPaintDevice::devicePixelRatioFScale());
+    default:
+        return QPaintDevice::metric(metric);
+    }
+}
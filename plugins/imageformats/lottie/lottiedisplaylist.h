@@ -0,0 +1,60 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QBrush>
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QPaintDevice>
+
+#include <memory>
+
+class QPainter;
+class LottieDisplayListPaintEngine;
+class LottieScanlineRasterizer;
+
+/*
+ * A baked frame: flattened geometry already mapped into the canvas coordinates
+ * of the animation together with the paint state needed to fill it. Replaying
+ * needs nothing from the element tree and works at any painter scale.
+*/
+
+class LottieDisplayList final
+{
+public:
+    LottieDisplayList() = default;
+
+    bool isEmpty() const;
+    qsizetype byteSize() const;
+    void replay(QPainter* painter,
+                LottieScanlineRasterizer* rasterizer = nullptr) const;
+
+private:
+    friend class LottieDisplayListPaintEngine;
+
+    enum Op : quint8 { SetClip, ClearClip, FillSolid, FillBrush, DrawImage };
+
+    QByteArray m_data;
+    QList<QBrush> m_brushes;
+    QList<QImage> m_images;
+};
+
+class LottieDisplayListRecorder final : public QPaintDevice
+{
+    Q_DISABLE_COPY(LottieDisplayListRecorder)
+
+public:
+    LottieDisplayListRecorder(LottieDisplayList* displayList, const QSize& size);
+    ~LottieDisplayListRecorder() override;
+
+    QPaintEngine* paintEngine() const override;
+
+protected:
+    int metric(PaintDeviceMetric metric) const override;
+
+private:
+    QSize m_size;
+    std::unique_ptr<LottieDisplayListPaintEngine> m_engine;
+};
@@ -12,14 +12,68 @@
 
 using namespace Qt::Literals;
 
+static LottieIOHandler::FrameCache defaultFrameCache()
+{
+    const QByteArray& frameCache = qgetenv("ACAYIP_LOTTIE_FRAME_CACHE");
+    if (frameCache == "vector"_ba)
+        return LottieIOHandler::VectorFrameCache;
+    if (frameCache == "raster"_ba)
+        return LottieIOHandler::RasterFrameCache;
+    if (frameCache == "compressed"_ba)
+        return LottieIOHandler::CompressedFrameCache;
+    return LottieIOHandler::NoFrameCache;
+}
+
+static LottieIOHandler::Rasterizer defaultRasterizer()
+{
+    if (qgetenv("ACAYIP_LOTTIE_RASTERIZER") == "scanline"_ba)
+        return LottieIOHandler::ScanlineRasterizer;
+    return LottieIOHandler::PainterRasterizer;
+}
+
 LottieIOHandler::LottieIOHandler()
     : QImageIOHandler()
     , m_startFrame(0)
     , m_endFrame(0)
     , m_currentFrame(0)
     , m_frameRate(30)
+    , m_frameCache(defaultFrameCache())
+    , m_rasterizer(defaultRasterizer())
+    , m_displayLists(32 * 1024) // In kilobytes
+    , m_rasterFrames(32 * 1024)
+    , m_compressedFrames(32 * 1024)
 {}
 
+LottieIOHandler::FrameCache LottieIOHandler::frameCache() const
+{
+    return m_frameCache;
+}
+
+void LottieIOHandler::setFrameCache(FrameCache frameCache)
+{
+    if (m_frameCache == frameCache)
+        return;
+    m_frameCache = frameCache;
+    m_displayLists.clear();
+    m_rasterFrames.clear();
+    m_compressedFrames.clear();
+}
+
+LottieIOHandler::Rasterizer LottieIOHandler::rasterizer() const
+{
+    return m_rasterizer;
+}
+
+// Display lists do not depend on the rasterizer, stored frames do
+void LottieIOHandler::setRasterizer(Rasterizer rasterizer)
+{
+    if (m_rasterizer == rasterizer)
+        return;
+    m_rasterizer = rasterizer;
+    m_rasterFrames.clear();
+    m_compressedFrames.clear();
+}
+
 bool LottieIOHandler::canRead() const
 {
     if (!device())
@@ -35,6 +89,20 @@ bool LottieIOHandler::read(QImage* image)
     if (m_currentFrame > m_endFrame)
         return false;
 
+    // Raster caches hand out stored frames without rendering anything
+    if (m_frameCache == RasterFrameCache) {
+        if (const QImage* cached = m_rasterFrames.object(m_currentFrame)) {
+            *image = *cached;
+            m_currentFrame++;
+            return true;
+        }
+    } else if (m_frameCache == CompressedFrameCache) {
+        if (m_compressedFrames.read(m_currentFrame, image)) {
+            m_currentFrame++;
+            return true;
+        }
+    }
+
     // Create a temporary image to render the frame
     QImage tempImage(m_scaledSize.isValid() ? m_scaledSize : m_size,
                      QImage::Format_ARGB32_Premultiplied);
@@ -52,16 +120,27 @@ bool LottieIOHandler::read(QImage* image)
                            | QPainter::LosslessImageRendering);
     painter.scale(sx, sy);
 
-    // Create a LottieRasterRenderer
-    LottieRasterRenderer renderer(&painter);
-
-    // Render the frame
-    BMBase frame(m_rootElement);
-    for (BMBase* elem : frame.children()) {
-        if (elem->active(m_currentFrame)) {
-            elem->updateProperties(m_currentFrame);
-            elem->render(renderer);
+    // Fills the scanline rasterizer does not support still go through QPainter
+    LottieScanlineRasterizer* rasterizer = m_rasterizer == ScanlineRasterizer
+                                               ? &m_scanlineRasterizer
+                                               : nullptr;
+
+    // Render the frame, either by replaying its baked geometry or directly
+    if (m_frameCache == VectorFrameCache) {
+        const LottieDisplayList* displayList = m_displayLists.object(m_currentFrame);
+        if (displayList) {
+            displayList->replay(&painter, rasterizer);
+        } else {
+            auto recorded = new LottieDisplayList(recordFrame(m_currentFrame));
+            recorded->replay(&painter, rasterizer);
+            m_displayLists.insert(m_currentFrame,
+                                  recorded,
+                                  qMax(1, int(recorded->byteSize() / 1024)));
         }
+    } else {
+        LottieRasterRenderer renderer(&painter);
+        renderer.setScanlineRasterizer(rasterizer);
+        renderFrame(renderer, m_currentFrame);
     }
 
     painter.end();
@@ -69,6 +148,14 @@ bool LottieIOHandler::read(QImage* image)
     // Copy the rendered frame to the output image
     *image = tempImage;
 
+    if (m_frameCache == RasterFrameCache) {
+        m_rasterFrames.insert(m_currentFrame,
+                              new QImage(tempImage),
+                              qMax(1, int(tempImage.sizeInBytes() / 1024)));
+    } else if (m_frameCache == CompressedFrameCache) {
+        m_compressedFrames.insert(m_currentFrame, tempImage);
+    }
+
     m_currentFrame++;
 
     return true;
@@ -93,8 +180,11 @@ QVariant LottieIOHandler::option(ImageOption option) const
 
 void LottieIOHandler::setOption(ImageOption option, const QVariant& value)
 {
-    if (option == ScaledSize)
+    if (option == ScaledSize && m_scaledSize != value.toSize()) {
         m_scaledSize = value.toSize();
+        m_rasterFrames.clear();
+        m_compressedFrames.clear();
+    }
 }
 
 bool LottieIOHandler::supportsOption(ImageOption option) const
@@ -152,6 +242,29 @@ bool LottieIOHandler::jumpToImage(int imageNumber)
     return false;
 }
 
+void LottieIOHandler::renderFrame(LottieRenderer& renderer, int frameNumber) const
+{
+    BMBase frame(m_rootElement);
+    for (BMBase* elem : frame.children()) {
+        if (elem->active(frameNumber)) {
+            elem->updateProperties(frameNumber);
+            elem->render(renderer);
+        }
+    }
+}
+
+LottieDisplayList LottieIOHandler::recordFrame(int frameNumber) const
+{
+    // Record at the canvas size, replays scale the result to whatever is needed
+    LottieDisplayList displayList;
+    LottieDisplayListRecorder recorder(&displayList, m_size);
+    QPainter painter(&recorder);
+    LottieRasterRenderer renderer(&painter);
+    renderFrame(renderer, frameNumber);
+    painter.end();
+    return displayList;
+}
+
 bool LottieIOHandler::load() const
 {
     if (m_rootElement.children().size() > 0)
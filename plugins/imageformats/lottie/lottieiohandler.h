@@ -3,8 +3,14 @@
 
 #pragma once
 
+#include "lottiecompressedframecache.h"
+#include "lottiedisplaylist.h"
+#include "lottiescanlinerasterizer.h"
+
 #include <QtBodymovin/private/bmbase_p.h>
+#include <QtBodymovin/private/lottierenderer_p.h>
 
+#include <QCache>
 #include <QImageIOHandler>
 #include <QVersionNumber>
 
@@ -13,8 +19,22 @@ class LottieIOHandler final : public QImageIOHandler
     Q_DISABLE_COPY(LottieIOHandler)
 
 public:
+    enum FrameCache {
+        NoFrameCache,
+        VectorFrameCache,
+        RasterFrameCache,
+        CompressedFrameCache
+    };
+    enum Rasterizer { PainterRasterizer, ScanlineRasterizer };
+
     LottieIOHandler();
 
+    FrameCache frameCache() const;
+    void setFrameCache(FrameCache frameCache);
+
+    Rasterizer rasterizer() const;
+    void setRasterizer(Rasterizer rasterizer);
+
     bool canRead() const override;
     bool read(QImage* image) override;
 
@@ -33,6 +53,8 @@ public:
 private:
     bool load() const;
     bool parse(const QByteArray& jsonSource) const;
+    void renderFrame(LottieRenderer& renderer, int frameNumber) const;
+    LottieDisplayList recordFrame(int frameNumber) const;
 
     mutable int m_startFrame;
     mutable int m_endFrame;
@@ -42,4 +64,10 @@ private:
     mutable QVersionNumber m_version;
     mutable BMBase m_rootElement;
     QSize m_scaledSize;
+    FrameCache m_frameCache;
+    Rasterizer m_rasterizer;
+    LottieScanlineRasterizer m_scanlineRasterizer;
+    QCache<int, LottieDisplayList> m_displayLists;
+    QCache<int, QImage> m_rasterFrames;
+    LottieCompressedFrameCache m_compressedFrames;
 };
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
 
 #include "lottierasterrenderer.h"
+#include "lottiescanlinerasterizer.h"
 
 #include <QBrush>
 #include <QGradient>
@@ -31,6 +32,11 @@ LottieRasterRenderer::LottieRasterRenderer(QPainter* painter)
     m_painter->setPen(QPen(Qt::NoPen));
 }
 
+void LottieRasterRenderer::setScanlineRasterizer(LottieScanlineRasterizer* rasterizer)
+{
+    m_rasterizer = rasterizer;
+}
+
 void LottieRasterRenderer::saveState()
 {
     m_painter->save();
@@ -89,7 +95,7 @@ void LottieRasterRenderer::render(const BMRect& rect)
             tp.addPath(m_clipPath);
             m_clipPath = tp;
         } else
-            m_painter->drawPath(rect.path());
+            drawPath(rect.path());
     }
 
     m_painter->restore();
@@ -112,7 +118,7 @@ void LottieRasterRenderer::render(const BMEllipse& ellipse)
             tp.addPath(m_clipPath);
             m_clipPath = tp;
         } else
-            m_painter->drawPath(ellipse.path());
+            drawPath(ellipse.path());
     }
 
     m_painter->restore();
@@ -147,7 +153,7 @@ void LottieRasterRenderer::render(const BMRound& round)
             tp.addPath(m_clipPath);
             m_clipPath = tp;
         } else
-            m_painter->drawPath(round.path());
+            drawPath(round.path());
     }
 
     m_painter->restore();
@@ -260,7 +266,7 @@ void LottieRasterRenderer::render(const BMFreeFormShape& shape)
             tp.addPath(m_clipPath);
             m_clipPath = tp;
         } else
-            m_painter->drawPath(shape.path());
+            drawPath(shape.path());
     }
 
     m_painter->restore();
@@ -280,7 +286,7 @@ void LottieRasterRenderer::render(const BMTrimPath& trimPath)
             // Do not use the applied transform, as the transform
             // is already included in m_unitedPath
             m_painter->setTransform(QTransform());
-            m_painter->drawPath(tr);
+            drawPath(tr);
         }
     }
 
@@ -313,6 +319,12 @@ void LottieRasterRenderer::render(const BMRepeater& repeater)
                          m_repeatOffset * m_repeaterTransform->position().y());
 }
 
+void LottieRasterRenderer::drawPath(const QPainterPath& path)
+{
+    if (!m_rasterizer || !m_rasterizer->drawPath(m_painter, path))
+        m_painter->drawPath(path);
+}
+
 void LottieRasterRenderer::applyRepeaterTransform(int instance)
 {
     if (!m_repeaterTransform || instance == 0)
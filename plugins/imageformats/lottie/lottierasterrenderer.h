@@ -12,12 +12,15 @@
 #include <QtBodymovin/private/lottierenderer_p.h>
 
 class QPainter;
+class LottieScanlineRasterizer;
 
 class LottieRasterRenderer final : public LottieRenderer
 {
 public:
     explicit LottieRasterRenderer(QPainter* m_painter);
 
+    void setScanlineRasterizer(LottieScanlineRasterizer* rasterizer);
+
     void saveState() override;
     void restoreState() override;
 
@@ -47,7 +50,9 @@ protected:
     qreal m_repeatOffset = 0.0;
     bool m_buildingClipRegion = false;
     QPainterPath m_clipPath;
+    LottieScanlineRasterizer* m_rasterizer = nullptr;
 
 private:
+    void drawPath(const QPainterPath& path);
     void applyRepeaterTransform(int instance);
 };
@@ -0,0 +1,614 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "lottiescanlinerasterizer.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QPainterPath>
+#include <QtCore/qsimd.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+// Same resolution QPainter uses for its gradient tables
+static constexpr int gradientTableSize = 1024;
+
+static inline quint32 byteMul(quint32 x, uint a)
+{
+    quint32 t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+static inline quint32 sourceOver(quint32 dst, quint32 src)
+{
+    return src + byteMul(dst, 255 - qAlpha(src));
+}
+
+static inline quint8 coverageAt(float accumulated, float scale, bool evenOdd)
+{
+    float coverage = std::abs(accumulated);
+    if (evenOdd) {
+        coverage -= 2.0f * std::floor(coverage * 0.5f);
+        coverage = std::min(coverage, 2.0f - coverage);
+    }
+    return quint8(std::min(coverage, 1.0f) * scale + 0.5f);
+}
+
+#if defined(__SSE2__)
+static inline __m128i byteMul16(__m128i x, __m128i a)
+{
+    __m128i t = _mm_mullo_epi16(x, a);
+    t = _mm_add_epi16(t, _mm_srli_epi16(t, 8));
+    t = _mm_add_epi16(t, _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(t, 8);
+}
+
+static inline void expandCoverage(const quint8* coverage, __m128i* c01, __m128i* c23)
+{
+    int packed;
+    std::memcpy(&packed, coverage, sizeof(packed));
+    __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), _mm_setzero_si128());
+    c = _mm_unpacklo_epi16(c, c);
+    *c01 = _mm_unpacklo_epi32(c, c);
+    *c23 = _mm_unpackhi_epi32(c, c);
+}
+
+static inline __m128i sourceOver4(__m128i dst, __m128i src01, __m128i src23)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i alpha01 = _mm_shufflehi_epi16(
+        _mm_shufflelo_epi16(src01, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i alpha23 = _mm_shufflehi_epi16(
+        _mm_shufflelo_epi16(src23, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i dst01 = byteMul16(_mm_unpacklo_epi8(dst, zero),
+                                    _mm_sub_epi16(full, alpha01));
+    const __m128i dst23 = byteMul16(_mm_unpackhi_epi8(dst, zero),
+                                    _mm_sub_epi16(full, alpha23));
+    return _mm_packus_epi16(_mm_add_epi16(src01, dst01), _mm_add_epi16(src23, dst23));
+}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline uint8x8_t byteMul8(uint8x8_t x, uint8x8_t a)
+{
+    // Same rounding as the scalar path, so both produce identical pixels
+    const uint16x8_t t = vmull_u8(x, a);
+    return vshrn_n_u16(vaddq_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), vdupq_n_u16(0x80)),
+                       8);
+}
+
+static inline uint8x8x2_t expandCoverage(const quint8* coverage)
+{
+    quint32 packed;
+    std::memcpy(&packed, coverage, sizeof(packed));
+    const uint8x8_t c = vreinterpret_u8_u32(vdup_n_u32(packed));
+    const uint8x8x2_t pairs = vzip_u8(c, c);
+    return vzip_u8(pairs.val[0], pairs.val[0]);
+}
+
+static inline uint8x8_t sourceOver2(uint8x8_t dst, uint8x8_t src)
+{
+    static const quint8 alphaIndices[8] = {3, 3, 3, 3, 7, 7, 7, 7};
+    const uint8x8_t alpha = vtbl1_u8(src, vld1_u8(alphaIndices));
+    return vadd_u8(src, byteMul8(dst, vmvn_u8(alpha)));
+}
+#endif
+
+// Turns the signed area deltas of a row into 8-bit coverage, the prefix sum is
+// done four cells at a time
+static void accumulate(const float* cells,
+                       quint8* coverage,
+                       int count,
+                       float scale,
+                       bool evenOdd)
+{
+    int x = 0;
+    float accumulated = 0.0f;
+
+#if defined(__SSE2__)
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    __m128 offset = _mm_setzero_ps();
+    for (; x + 4 <= count; x += 4) {
+        __m128 v = _mm_loadu_ps(cells + x);
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+        v = _mm_add_ps(v, offset);
+        offset = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128 c = _mm_andnot_ps(signMask, v);
+        if (evenOdd) {
+            const __m128 wraps = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(c, half)));
+            c = _mm_sub_ps(c, _mm_mul_ps(wraps, two));
+            c = _mm_min_ps(c, _mm_sub_ps(two, c));
+        }
+        c = _mm_min_ps(c, one);
+
+        __m128i packed = _mm_cvtps_epi32(_mm_mul_ps(c, scale4));
+        packed = _mm_packs_epi32(packed, packed);
+        packed = _mm_packus_epi16(packed, packed);
+        const int bytes = _mm_cvtsi128_si32(packed);
+        std::memcpy(coverage + x, &bytes, sizeof(bytes));
+    }
+    accumulated = _mm_cvtss_f32(offset);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t two = vdupq_n_f32(2.0f);
+    float32x4_t offset = zero;
+    for (; x + 4 <= count; x += 4) {
+        float32x4_t v = vld1q_f32(cells + x);
+        v = vaddq_f32(v, vextq_f32(zero, v, 3));
+        v = vaddq_f32(v, vextq_f32(zero, v, 2));
+        v = vaddq_f32(v, offset);
+        offset = vdupq_n_f32(vgetq_lane_f32(v, 3));
+
+        float32x4_t c = vabsq_f32(v);
+        if (evenOdd) {
+            const float32x4_t halves = vmulq_n_f32(c, 0.5f);
+            const float32x4_t wraps = vcvtq_f32_s32(vcvtq_s32_f32(halves));
+            c = vsubq_f32(c, vmulq_f32(wraps, two));
+            c = vminq_f32(c, vsubq_f32(two, c));
+        }
+        c = vminq_f32(c, one);
+
+        const uint32x4_t rounded = vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(c, scale),
+                                                           vdupq_n_f32(0.5f)));
+        const uint16x4_t narrow = vmovn_u32(rounded);
+        const uint8x8_t bytes = vmovn_u16(vcombine_u16(narrow, narrow));
+        const quint32 packed = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+        std::memcpy(coverage + x, &packed, sizeof(packed));
+    }
+    accumulated = vgetq_lane_f32(offset, 0);
+#endif
+
+    for (; x < count; ++x) {
+        accumulated += cells[x];
+        coverage[x] = coverageAt(accumulated, scale, evenOdd);
+    }
+}
+
+static void blendSolid(quint32* dst, quint32 color, const quint8* coverage, int count)
+{
+    const bool opaque = qAlpha(color) == 255;
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32(int(color)),
+                                              _mm_setzero_si128());
+    for (; x + 4 <= count; x += 4) {
+        quint32 packed;
+        std::memcpy(&packed, coverage + x, sizeof(packed));
+        if (packed == 0)
+            continue;
+        auto pixels = reinterpret_cast<__m128i*>(dst + x);
+        if (packed == 0xffffffff && opaque) {
+            _mm_storeu_si128(pixels, _mm_set1_epi32(int(color)));
+            continue;
+        }
+        __m128i c01, c23;
+        expandCoverage(coverage + x, &c01, &c23);
+        _mm_storeu_si128(pixels,
+                         sourceOver4(_mm_loadu_si128(pixels),
+                                     byteMul16(color16, c01),
+                                     byteMul16(color16, c23)));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x8_t color8 = vreinterpret_u8_u32(vdup_n_u32(color));
+    for (; x + 4 <= count; x += 4) {
+        quint32 packed;
+        std::memcpy(&packed, coverage + x, sizeof(packed));
+        if (packed == 0)
+            continue;
+        auto pixels = reinterpret_cast<quint8*>(dst + x);
+        if (packed == 0xffffffff && opaque) {
+            vst1q_u32(dst + x, vdupq_n_u32(color));
+            continue;
+        }
+        const uint8x8x2_t c = expandCoverage(coverage + x);
+        const uint8x16_t d = vld1q_u8(pixels);
+        vst1q_u8(pixels,
+                 vcombine_u8(sourceOver2(vget_low_u8(d), byteMul8(color8, c.val[0])),
+                             sourceOver2(vget_high_u8(d), byteMul8(color8, c.val[1]))));
+    }
+#endif
+
+    for (; x < count; ++x) {
+        const uint a = coverage[x];
+        if (a == 255 && opaque)
+            dst[x] = color;
+        else if (a)
+            dst[x] = sourceOver(dst[x], byteMul(color, a));
+    }
+}
+
+static void blendSpan(quint32* dst,
+                      const quint32* src,
+                      const quint8* coverage,
+                      int count)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 4 <= count; x += 4) {
+        quint32 packed;
+        std::memcpy(&packed, coverage + x, sizeof(packed));
+        if (packed == 0)
+            continue;
+        __m128i c01, c23;
+        expandCoverage(coverage + x, &c01, &c23);
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        auto pixels = reinterpret_cast<__m128i*>(dst + x);
+        _mm_storeu_si128(pixels,
+                         sourceOver4(_mm_loadu_si128(pixels),
+                                     byteMul16(_mm_unpacklo_epi8(s, zero), c01),
+                                     byteMul16(_mm_unpackhi_epi8(s, zero), c23)));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; x + 4 <= count; x += 4) {
+        quint32 packed;
+        std::memcpy(&packed, coverage + x, sizeof(packed));
+        if (packed == 0)
+            continue;
+        const uint8x8x2_t c = expandCoverage(coverage + x);
+        const uint8x16_t s = vld1q_u8(reinterpret_cast<const quint8*>(src + x));
+        auto pixels = reinterpret_cast<quint8*>(dst + x);
+        const uint8x16_t d = vld1q_u8(pixels);
+        const uint8x8_t low = byteMul8(vget_low_u8(s), c.val[0]);
+        const uint8x8_t high = byteMul8(vget_high_u8(s), c.val[1]);
+        vst1q_u8(pixels,
+                 vcombine_u8(sourceOver2(vget_low_u8(d), low),
+                             sourceOver2(vget_high_u8(d), high)));
+    }
+#endif
+
+    for (; x < count; ++x) {
+        if (const uint a = coverage[x])
+            dst[x] = sourceOver(dst[x], byteMul(src[x], a));
+    }
+}
+
+static int gradientIndex(qreal t, QGradient::Spread spread)
+{
+    if (spread == QGradient::RepeatSpread) {
+        t -= std::floor(t);
+    } else if (spread == QGradient::ReflectSpread) {
+        t = std::fmod(std::abs(t), 2.0);
+        if (t > 1.0)
+            t = 2.0 - t;
+    } else {
+        t = qBound(0.0, t, 1.0);
+    }
+    return int(t * (gradientTableSize - 1) + 0.5);
+}
+
+bool LottieScanlineRasterizer::drawPath(QPainter* painter, const QPainterPath& path)
+{
+    QPaintDevice* device = painter->device();
+    if (!device || device->devType() != QInternal::Image)
+        return false;
+
+    auto image = static_cast<QImage*>(device);
+    if (image->format() != QImage::Format_ARGB32_Premultiplied || painter->hasClipping()
+        || painter->compositionMode() != QPainter::CompositionMode_SourceOver
+        || !painter->testRenderHint(QPainter::Antialiasing)) {
+        return false;
+    }
+
+    const QTransform& transform = painter->deviceTransform();
+    const QBrush& brush = painter->brush();
+    const QPen& pen = painter->pen();
+    const bool filled = brush.style() != Qt::NoBrush;
+    const bool stroked = pen.style() != Qt::NoPen && pen.brush().style() != Qt::NoBrush;
+    if ((filled && !isSupported(brush, transform))
+        || (stroked && (pen.isCosmetic() || !isSupported(pen.brush(), transform)))) {
+        return false;
+    }
+
+    if (filled) {
+        fill(image,
+             path.toSubpathPolygons(transform),
+             path.fillRule(),
+             brush,
+             transform,
+             painter->opacity());
+    }
+
+    if (stroked) {
+        const QPainterPath& stroke = QPainterPathStroker(pen).createStroke(path);
+        fill(image,
+             stroke.toSubpathPolygons(transform),
+             Qt::WindingFill,
+             pen.brush(),
+             transform,
+             painter->opacity());
+    }
+
+    return true;
+}
+
+bool LottieScanlineRasterizer::isSupported(const QBrush& brush,
+                                           const QTransform& transform)
+{
+    if (brush.style() == Qt::SolidPattern)
+        return true;
+
+    if (brush.style() != Qt::LinearGradientPattern
+        && brush.style() != Qt::RadialGradientPattern) {
+        return false;
+    }
+
+    const QGradient* gradient = brush.gradient();
+    const QTransform& brushTransform = brush.transform() * transform;
+    if (gradient->coordinateMode() != QGradient::LogicalMode
+        || gradient->interpolationMode() != QGradient::ColorInterpolation
+        || gradient->stops().isEmpty() || !brushTransform.isAffine()
+        || !brushTransform.isInvertible()) {
+        return false;
+    }
+
+    if (gradient->type() == QGradient::LinearGradient) {
+        auto linear = static_cast<const QLinearGradient*>(gradient);
+        return linear->start() != linear->finalStop();
+    }
+
+    // Focal gradients are left to QPainter, lottie rarely uses highlights
+    auto radial = static_cast<const QRadialGradient*>(gradient);
+    return radial->radius() > 0 && radial->focalPoint() == radial->center()
+           && qFuzzyIsNull(radial->focalRadius());
+}
+
+void LottieScanlineRasterizer::fill(QImage* image,
+                                    const QList<QPolygonF>& polygons,
+                                    Qt::FillRule fillRule,
+                                    const QBrush& brush,
+                                    const QTransform& transform,
+                                    qreal opacity)
+{
+    QRectF bounds;
+    for (const QPolygonF& polygon : polygons)
+        bounds |= polygon.boundingRect();
+
+    const QRect& area = bounds.toAlignedRect() & image->rect();
+    if (area.isEmpty())
+        return;
+
+    // Two extra cells per row take the contributions of edges that touch the
+    // right border, the cell buffer is kept zeroed between fills
+    m_width = area.width();
+    m_height = area.height();
+    m_stride = m_width + 2;
+    if (m_cells.size() < qsizetype(m_stride) * m_height)
+        m_cells.resize(qsizetype(m_stride) * m_height);
+    if (m_coverage.size() < m_width)
+        m_coverage.resize(m_width);
+
+    const QPointF origin(area.topLeft());
+    for (const QPolygonF& polygon : polygons) {
+        for (qsizetype i = 0; i < polygon.size(); ++i) {
+            addClippedLine(polygon[i] - origin,
+                           polygon[(i + 1) % polygon.size()] - origin);
+        }
+    }
+
+    const bool solid = brush.style() == Qt::SolidPattern;
+    const quint32 color = qPremultiply(brush.color().rgba());
+    QTransform inverted;
+    if (!solid) {
+        inverted = (brush.transform() * transform).inverted();
+        updateGradientTable(*brush.gradient());
+    }
+
+    uchar* bits = image->bits();
+    const qsizetype bytesPerLine = image->bytesPerLine();
+    const float scale = 255.0f * float(opacity);
+    const bool evenOdd = fillRule == Qt::OddEvenFill;
+    quint8* coverage = m_coverage.data();
+
+    for (int y = 0; y < m_height; ++y) {
+        float* cells = m_cells.data() + qsizetype(y) * m_stride;
+        accumulate(cells, coverage, m_width, scale, evenOdd);
+        std::fill_n(cells, m_stride, 0.0f);
+
+        int begin = 0;
+        while (begin < m_width && !coverage[begin])
+            ++begin;
+        if (begin == m_width)
+            continue;
+        int end = m_width;
+        while (!coverage[end - 1])
+            --end;
+
+        auto dst = reinterpret_cast<quint32*>(bits + (area.y() + y) * bytesPerLine)
+                   + area.x() + begin;
+        if (solid) {
+            blendSolid(dst, color, coverage + begin, end - begin);
+        } else {
+            const QPointF center(area.x() + begin + 0.5, area.y() + y + 0.5);
+            fetchGradient(brush, inverted, center, end - begin);
+            blendSpan(dst, m_span.constData(), coverage + begin, end - begin);
+        }
+    }
+}
+
+void LottieScanlineRasterizer::addClippedLine(QPointF from, QPointF to)
+{
+    // Parts left of the area keep contributing as vertical edges on its border,
+    // parts right of it end up in the spare cells and never reach a pixel
+    const qreal right = m_width;
+    qreal splits[2];
+    int splitCount = 0;
+    if (from.x() != to.x()) {
+        for (const qreal border : {0.0, right}) {
+            const qreal t = (border - from.x()) / (to.x() - from.x());
+            if (t > 0.0 && t < 1.0)
+                splits[splitCount++] = t;
+        }
+        if (splitCount == 2 && splits[0] > splits[1])
+            std::swap(splits[0], splits[1]);
+    }
+
+    auto clamped = [right](QPointF point) {
+        return QPointF(qBound(0.0, point.x(), right), point.y());
+    };
+
+    QPointF previous = from;
+    for (int i = 0; i < splitCount; ++i) {
+        const QPointF split = from + (to - from) * splits[i];
+        addLine(clamped(previous), clamped(split));
+        previous = split;
+    }
+    addLine(clamped(previous), clamped(to));
+}
+
+void LottieScanlineRasterizer::addLine(QPointF from, QPointF to)
+{
+    if (std::abs(from.y() - to.y()) < 1e-6)
+        return;
+
+    float direction = 1.0f;
+    if (from.y() > to.y()) {
+        std::swap(from, to);
+        direction = -1.0f;
+    }
+
+    const float x0 = from.x();
+    const float y0 = from.y();
+    const float y1 = to.y();
+    const float dxdy = (to.x() - from.x()) / (to.y() - from.y());
+    const int yBegin = std::max(0, int(std::floor(y0)));
+    const int yEnd = std::min(m_height, int(std::ceil(y1)));
+    float x = x0 + (std::max(y0, float(yBegin)) - y0) * dxdy;
+
+    for (int y = yBegin; y < yEnd; ++y) {
+        float* cells = m_cells.data() + qsizetype(y) * m_stride;
+        const float dy = std::min(float(y + 1), y1) - std::max(float(y), y0);
+        const float xNext = std::clamp(x + dxdy * dy, 0.0f, float(m_width));
+        const float d = dy * direction;
+        const float left = std::min(x, xNext);
+        const float right = std::max(x, xNext);
+        const float leftFloor = std::floor(left);
+        const int leftCell = int(leftFloor);
+        const float rightCeil = std::ceil(right);
+        const int rightCell = int(rightCeil);
+
+        if (rightCell <= leftCell + 1) {
+            // The edge stays within one pixel on this row
+            const float middle = 0.5f * (x + xNext) - leftFloor;
+            cells[leftCell] += d - d * middle;
+            cells[leftCell + 1] += d * middle;
+        } else {
+            const float s = 1.0f / (right - left);
+            const float leftFraction = left - leftFloor;
+            const float a0 = 0.5f * s * (1.0f - leftFraction) * (1.0f - leftFraction);
+            const float rightFraction = right - rightCeil + 1.0f;
+            const float am = 0.5f * s * rightFraction * rightFraction;
+            cells[leftCell] += d * a0;
+            if (rightCell == leftCell + 2) {
+                cells[leftCell + 1] += d * (1.0f - a0 - am);
+            } else {
+                const float a1 = s * (1.5f - leftFraction);
+                cells[leftCell + 1] += d * (a1 - a0);
+                for (int cell = leftCell + 2; cell < rightCell - 1; ++cell)
+                    cells[cell] += d * s;
+                const float a2 = a1 + (rightCell - leftCell - 3) * s;
+                cells[rightCell - 1] += d * (1.0f - a2 - am);
+            }
+            cells[rightCell] += d * am;
+        }
+
+        x = xNext;
+    }
+}
+
+void LottieScanlineRasterizer::fetchGradient(const QBrush& brush,
+                                             const QTransform& inverted,
+                                             QPointF origin,
+                                             int count)
+{
+    if (m_span.size() < count)
+        m_span.resize(count);
+
+    // Affine, so stepping one pixel right is a constant step in gradient space
+    quint32* span = m_span.data();
+    const quint32* table = m_gradientTable.constData();
+    const QGradient* gradient = brush.gradient();
+    const QGradient::Spread spread = gradient->spread();
+    const QPointF& start = inverted.map(origin);
+    const QPointF step(inverted.m11(), inverted.m12());
+
+    if (gradient->type() == QGradient::LinearGradient) {
+        auto linear = static_cast<const QLinearGradient*>(gradient);
+        const QPointF& axis = linear->finalStop() - linear->start();
+        const qreal scale = 1.0 / QPointF::dotProduct(axis, axis);
+        const qreal dt = QPointF::dotProduct(step, axis) * scale;
+        qreal t = QPointF::dotProduct(start - linear->start(), axis) * scale;
+        for (int x = 0; x < count; ++x, t += dt)
+            span[x] = table[gradientIndex(t, spread)];
+    } else {
+        auto radial = static_cast<const QRadialGradient*>(gradient);
+        const qreal scale = 1.0 / radial->radius();
+        QPointF point = start - radial->center();
+        for (int x = 0; x < count; ++x, point += step) {
+            const qreal t = std::sqrt(QPointF::dotProduct(point, point)) * scale;
+            span[x] = table[gradientIndex(t, spread)];
+        }
+    }
+}
+
+void LottieScanlineRasterizer::updateGradientTable(const QGradient& gradient)
+{
+    const QGradientStops& stops = gradient.stops();
+    if (!m_gradientTable.isEmpty() && stops == m_gradientStops)
+        return;
+
+    m_gradientStops = stops;
+    m_gradientTable.resize(gradientTableSize);
+
+    // Stops are interpolated premultiplied, like QGradient::ColorInterpolation
+    auto premultiplied = [](const QColor& color) {
+        const qreal alpha = color.alphaF();
+        return std::array<qreal, 4>{color.redF() * alpha,
+                                    color.greenF() * alpha,
+                                    color.blueF() * alpha,
+                                    alpha};
+    };
+
+    qsizetype stop = 0;
+    for (int i = 0; i < gradientTableSize; ++i) {
+        const qreal t = i / qreal(gradientTableSize - 1);
+        while (stop + 1 < stops.size() && stops[stop + 1].first <= t)
+            ++stop;
+
+        std::array<qreal, 4> color = premultiplied(stops[stop].second);
+        if (t > stops[stop].first && stop + 1 < stops.size()) {
+            const std::array<qreal, 4>& next = premultiplied(stops[stop + 1].second);
+            const qreal range = stops[stop + 1].first - stops[stop].first;
+            const qreal f = range > 0 ? (t - stops[stop].first) / range : 0.0;
+            for (int c = 0; c < 4; ++c)
+                color[c] += (next[c] - color[c]) * f;
+        }
+
+        m_gradientTable[i] = qRgba(qRound(color[0] * 255),
+                                   qRound(color[1] * 255),
+                                   qRound(color[2] * 255),
+                                   qRound(color[3] * 255));
+    }
+}
@@ -0,0 +1,57 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QBrush>
+#include <QList>
+#include <QPolygonF>
+#include <QTransform>
+
+class QImage;
+class QPainter;
+class QPainterPath;
+
+/*
+ * Fills paths straight into an ARGB32 premultiplied image by accumulating the
+ * signed area every edge covers and converting the running sum into coverage.
+ * Only what lottie needs is handled (source-over, solid and simple gradient
+ * brushes, no clipping), drawPath() returns false for everything else so that
+ * the caller can fall back to QPainter.
+*/
+
+class LottieScanlineRasterizer final
+{
+    Q_DISABLE_COPY(LottieScanlineRasterizer)
+
+public:
+    LottieScanlineRasterizer() = default;
+
+    bool drawPath(QPainter* painter, const QPainterPath& path);
+
+private:
+    static bool isSupported(const QBrush& brush, const QTransform& transform);
+
+    void fill(QImage* image,
+              const QList<QPolygonF>& polygons,
+              Qt::FillRule fillRule,
+              const QBrush& brush,
+              const QTransform& transform,
+              qreal opacity);
+    void addLine(QPointF from, QPointF to);
+    void addClippedLine(QPointF from, QPointF to);
+    void fetchGradient(const QBrush& brush,
+                       const QTransform& inverted,
+                       QPointF origin,
+                       int count);
+    void updateGradientTable(const QGradient& gradient);
+
+    QList<float> m_cells;
+    QList<quint8> m_coverage;
+    QList<quint32> m_span;
+    QList<quint32> m_gradientTable;
+    QGradientStops m_gradientStops;
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0;
+};
@@ -0,0 +1,77 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "atlaspacker.h"
+
+#include <algorithm>
+#include <numeric>
+
+AtlasPacker::AtlasPacker(const QSize& maximumPageSize, int padding)
+    : m_maximumPageSize(maximumPageSize)
+    , m_padding(qMax(0, padding))
+{}
+
+bool AtlasPacker::pack(const QList<QSize>& sizes, QList<Placement>* placements)
+{
+    m_shelves.clear();
+    m_pageSizes.clear();
+    placements->fill(Placement(), sizes.size());
+
+    QList<int> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sizes](int a, int b) {
+        if (sizes[a].height() != sizes[b].height())
+            return sizes[a].height() > sizes[b].height();
+        return sizes[a].width() > sizes[b].width();
+    });
+
+    for (int index : std::as_const(order)) {
+        const QSize& size = sizes[index];
+        if (size.isEmpty()) {
+            (*placements)[index] = {0, QRect()};
+            continue;
+        }
+
+        const int w = size.width() + m_padding;
+        const int h = size.height() + m_padding;
+        if (w > m_maximumPageSize.width() || h > m_maximumPageSize.height())
+            return false;
+
+        Shelf* shelf = nullptr;
+        for (Shelf& candidate : m_shelves) {
+            if (h <= candidate.height && candidate.x + w <= m_maximumPageSize.width()) {
+                shelf = &candidate;
+                break;
+            }
+        }
+
+        if (!shelf) {
+            int page = m_pageSizes.isEmpty() ? 0 : m_pageSizes.size() - 1;
+            int y = 0;
+            for (const Shelf& s : std::as_const(m_shelves)) {
+                if (s.page == page)
+                    y = qMax(y, s.y + s.height);
+            }
+            if (m_pageSizes.isEmpty() || y + h > m_maximumPageSize.height()) {
+                page = m_pageSizes.size();
+                m_pageSizes.append(QSize());
+                y = 0;
+            }
+            m_shelves.append({page, y, h, 0});
+            shelf = &m_shelves.last();
+        }
+
+        (*placements)[index] = {shelf->page, QRect(QPoint(shelf->x, shelf->y), size)};
+        shelf->x += w;
+
+        QSize& pageSize = m_pageSizes[shelf->page];
+        pageSize = pageSize.expandedTo({shelf->x, shelf->y + h});
+    }
+
+    return true;
+}
+
+QList<QSize> AtlasPacker::pageSizes() const
+{
+    return m_pageSizes;
+}
@@ -0,0 +1,41 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QList>
+#include <QRect>
+
+/*
+ * Shelf packer: rectangles are sorted by decreasing height and laid out on
+ * horizontal shelves, a new page is opened whenever a page runs out of room.
+*/
+
+class AtlasPacker final
+{
+public:
+    struct Placement
+    {
+        int page = -1;
+        QRect rect;
+    };
+
+    AtlasPacker(const QSize& maximumPageSize, int padding);
+
+    bool pack(const QList<QSize>& sizes, QList<Placement>* placements);
+    QList<QSize> pageSizes() const;
+
+private:
+    struct Shelf
+    {
+        int page = 0;
+        int y = 0;
+        int height = 0;
+        int x = 0;
+    };
+
+    QSize m_maximumPageSize;
+    int m_padding;
+    QList<Shelf> m_shelves;
+    QList<QSize> m_pageSizes;
+};
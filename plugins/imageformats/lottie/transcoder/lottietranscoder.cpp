@@ -0,0 +1,378 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "lottietranscoder.h"
+#include "atlaspacker.h"
+#include "lottieiohandler.h"
+#include "workstealingscheduler.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMultiHash>
+#include <QMutex>
+#include <QPainter>
+#include <QThread>
+
+using namespace Qt::Literals;
+
+static QRect opaqueBounds(const QImage& image)
+{
+    int top = image.height();
+    int bottom = -1;
+    int left = image.width();
+    int right = -1;
+
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        int x = 0;
+        while (x < image.width() && qAlpha(line[x]) == 0)
+            ++x;
+        if (x == image.width())
+            continue;
+        int xr = image.width() - 1;
+        while (xr > x && qAlpha(line[xr]) == 0)
+            --xr;
+        top = qMin(top, y);
+        bottom = y;
+        left = qMin(left, x);
+        right = qMax(right, xr);
+    }
+
+    if (bottom < 0)
+        return QRect();
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+bool LottieTranscoder::load(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_errorString = u"Cannot open %1: %2"_s.arg(filePath, file.errorString());
+        return false;
+    }
+
+    m_source = file.readAll();
+    m_baseName = QFileInfo(filePath).completeBaseName();
+
+    QBuffer buffer(&m_source);
+    LottieIOHandler handler;
+    handler.setDevice(&buffer);
+    if (!handler.canRead()) {
+        m_errorString = u"%1 is not a valid lottie file"_s.arg(filePath);
+        return false;
+    }
+
+    m_size = handler.option(QImageIOHandler::Size).toSize();
+    m_frameCount = handler.imageCount();
+    m_frameDelay = handler.nextImageDelay();
+    return true;
+}
+
+bool LottieTranscoder::transcode(const Options& options)
+{
+    if (m_frameCount <= 0) {
+        m_errorString = u"Nothing to transcode"_s;
+        return false;
+    }
+
+    if (!QDir().mkpath(QDir(options.outputDirectory).absolutePath())) {
+        m_errorString = u"Cannot create the output directory %1"_s.arg(
+            options.outputDirectory);
+        return false;
+    }
+
+    const int first = qBound(0, options.firstFrame, m_frameCount - 1);
+    const int last = options.lastFrame < 0
+                         ? m_frameCount - 1
+                         : qBound(first, options.lastFrame, m_frameCount - 1);
+    const QString& suffix = QString::fromLatin1(options.format).toLower();
+
+    // Every worker parses its own copy of the document, element trees are not
+    // safe to share between threads while their properties are being updated
+    struct Worker
+    {
+        QBuffer buffer;
+        LottieIOHandler handler;
+    };
+
+    WorkStealingScheduler scheduler(options.threadCount > 0
+                                        ? options.threadCount
+                                        : QThread::idealThreadCount());
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < scheduler.threadCount(); ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->buffer.setData(m_source);
+        worker->handler.setDevice(&worker->buffer);
+        if (options.scaledSize.isValid())
+            worker->handler.setOption(QImageIOHandler::ScaledSize, options.scaledSize);
+        workers.push_back(std::move(worker));
+    }
+
+    QList<Frame> frames(options.spriteSheet ? last - first + 1 : 0);
+    Frame* framesData = frames.data();
+
+    QMutex errorMutex;
+    QAtomicInt failed;
+    auto fail = [&](const QString& errorString) {
+        QMutexLocker locker(&errorMutex);
+        if (failed.testAndSetRelaxed(0, 1))
+            m_errorString = errorString;
+    };
+
+    scheduler.run(first, last + 1, [&](int worker, int number) {
+        if (failed.loadRelaxed())
+            return;
+
+        LottieIOHandler& handler = workers[worker]->handler;
+        QImage image;
+        if (!handler.jumpToImage(number) || !handler.read(&image)) {
+            fail(u"Cannot render frame %1"_s.arg(number));
+            return;
+        }
+
+        if (options.spriteSheet) {
+            Frame& frame = framesData[number - first];
+            const QRect& bounds = options.trim ? opaqueBounds(image) : image.rect();
+            if (bounds == image.rect())
+                frame.image = std::move(image);
+            else if (!bounds.isEmpty())
+                frame.image = image.copy(bounds);
+            frame.offset = bounds.topLeft();
+        } else {
+            QImageWriter writer(outputFilePath(options, suffix, number),
+                                options.format);
+            if (!writer.write(image)) {
+                fail(u"Cannot write %1: %2"_s.arg(writer.fileName(),
+                                                  writer.errorString()));
+            }
+        }
+    });
+
+    if (failed.loadRelaxed())
+        return false;
+
+    if (options.spriteSheet) {
+        const QSize& frameSize = options.scaledSize.isValid() ? options.scaledSize
+                                                              : m_size;
+        return writeSpriteSheet(options, frameSize, frames);
+    }
+
+    return true;
+}
+
+int LottieTranscoder::verifyRasterizer(const Options& options)
+{
+    if (m_frameCount <= 0) {
+        m_errorString = u"Nothing to verify"_s;
+        return -1;
+    }
+
+    const int first = qBound(0, options.firstFrame, m_frameCount - 1);
+    const int last = options.lastFrame < 0
+                         ? m_frameCount - 1
+                         : qBound(first, options.lastFrame, m_frameCount - 1);
+
+    // Renders every frame with both backends, the result is the largest
+    // difference seen on a single channel
+    struct Worker
+    {
+        QBuffer referenceBuffer;
+        QBuffer scanlineBuffer;
+        LottieIOHandler reference;
+        LottieIOHandler scanline;
+        int difference = 0;
+    };
+
+    WorkStealingScheduler scheduler(options.threadCount > 0
+                                        ? options.threadCount
+                                        : QThread::idealThreadCount());
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < scheduler.threadCount(); ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->referenceBuffer.setData(m_source);
+        worker->scanlineBuffer.setData(m_source);
+        worker->reference.setDevice(&worker->referenceBuffer);
+        worker->scanline.setDevice(&worker->scanlineBuffer);
+        worker->reference.setRasterizer(LottieIOHandler::PainterRasterizer);
+        worker->scanline.setRasterizer(LottieIOHandler::ScanlineRasterizer);
+        if (options.scaledSize.isValid()) {
+            worker->reference.setOption(QImageIOHandler::ScaledSize,
+                                        options.scaledSize);
+            worker->scanline.setOption(QImageIOHandler::ScaledSize,
+                                       options.scaledSize);
+        }
+        workers.push_back(std::move(worker));
+    }
+
+    QAtomicInt failed;
+    scheduler.run(first, last + 1, [&](int worker, int number) {
+        Worker& w = *workers[worker];
+        QImage reference;
+        QImage scanline;
+        if (!w.reference.jumpToImage(number) || !w.reference.read(&reference)
+            || !w.scanline.jumpToImage(number) || !w.scanline.read(&scanline)) {
+            failed.storeRelaxed(1);
+            return;
+        }
+
+        for (int y = 0; y < reference.height(); ++y) {
+            auto a = reinterpret_cast<const QRgb*>(reference.constScanLine(y));
+            auto b = reinterpret_cast<const QRgb*>(scanline.constScanLine(y));
+            for (int x = 0; x < reference.width(); ++x) {
+                for (int shift = 0; shift < 32; shift += 8) {
+                    const int d = qAbs(int((a[x] >> shift) & 0xff)
+                                       - int((b[x] >> shift) & 0xff));
+                    w.difference = qMax(w.difference, d);
+                }
+            }
+        }
+    });
+
+    if (failed.loadRelaxed()) {
+        m_errorString = u"Cannot render the frames to compare"_s;
+        return -1;
+    }
+
+    int difference = 0;
+    for (const auto& worker : workers)
+        difference = qMax(difference, worker->difference);
+    return difference;
+}
+
+bool LottieTranscoder::writeSpriteSheet(const Options& options,
+                                        const QSize& frameSize,
+                                        const QList<Frame>& frames)
+{
+    const QString& suffix = QString::fromLatin1(options.format).toLower();
+
+    // Identical frames (holds are common in UI animations) share one atlas cell
+    QList<int> cells(frames.size(), -1);
+    QList<int> cellFrames;
+    QList<QSize> cellSizes;
+    QMultiHash<size_t, int> framesByContent;
+    for (int i = 0; i < frames.size(); ++i) {
+        const QImage& image = frames[i].image;
+        if (image.isNull())
+            continue;
+        const size_t hash = qHash(
+            QByteArrayView(image.constBits(), image.sizeInBytes()));
+        for (auto it = framesByContent.constFind(hash);
+             it != framesByContent.cend() && it.key() == hash;
+             ++it) {
+            if (frames[*it].image == image) {
+                cells[i] = cells[*it];
+                break;
+            }
+        }
+        if (cells[i] < 0) {
+            cells[i] = cellFrames.size();
+            cellFrames.append(i);
+            cellSizes.append(image.size());
+            framesByContent.insert(hash, i);
+        }
+    }
+
+    AtlasPacker packer({options.maximumPageSize, options.maximumPageSize},
+                       options.padding);
+    QList<AtlasPacker::Placement> placements;
+    if (!packer.pack(cellSizes, &placements)) {
+        m_errorString = u"Frames do not fit into %1x%1 pages"_s.arg(
+            options.maximumPageSize);
+        return false;
+    }
+
+    const QList<QSize>& pageSizes = packer.pageSizes();
+    QList<QImage> pages;
+    for (const QSize& pageSize : pageSizes) {
+        QImage page(pageSize, QImage::Format_ARGB32_Premultiplied);
+        page.fill(Qt::transparent);
+        pages.append(page);
+    }
+
+    for (int cell = 0; cell < cellFrames.size(); ++cell) {
+        const AtlasPacker::Placement& placement = placements[cell];
+        QPainter painter(&pages[placement.page]);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(placement.rect.topLeft(), frames[cellFrames[cell]].image);
+    }
+
+    QJsonArray pageArray;
+    for (int i = 0; i < pages.size(); ++i) {
+        const QString& filePath = outputFilePath(options,
+                                                 suffix,
+                                                 pages.size() > 1 ? i : -1);
+        QImageWriter writer(filePath, options.format);
+        if (!writer.write(pages[i])) {
+            m_errorString = u"Cannot write %1: %2"_s.arg(filePath,
+                                                         writer.errorString());
+            return false;
+        }
+        pageArray.append(QFileInfo(filePath).fileName());
+    }
+
+    QJsonArray frameArray;
+    for (int i = 0; i < frames.size(); ++i) {
+        QJsonObject frame;
+        if (cells[i] >= 0) {
+            const AtlasPacker::Placement& placement = placements[cells[i]];
+            frame.insert(u"page"_s, placement.page);
+            frame.insert(u"x"_s, placement.rect.x());
+            frame.insert(u"y"_s, placement.rect.y());
+            frame.insert(u"w"_s, placement.rect.width());
+            frame.insert(u"h"_s, placement.rect.height());
+            frame.insert(u"offsetX"_s, frames[i].offset.x());
+            frame.insert(u"offsetY"_s, frames[i].offset.y());
+        }
+        frameArray.append(frame);
+    }
+
+    QJsonObject root;
+    root.insert(u"frameWidth"_s, frameSize.width());
+    root.insert(u"frameHeight"_s, frameSize.height());
+    root.insert(u"frameDelay"_s, m_frameDelay);
+    root.insert(u"pages"_s, pageArray);
+    root.insert(u"frames"_s, frameArray);
+
+    QFile file(outputFilePath(options, u"json"_s));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || file.write(QJsonDocument(root).toJson()) < 0) {
+        m_errorString = u"Cannot write %1: %2"_s.arg(file.fileName(),
+                                                     file.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+QString LottieTranscoder::outputFilePath(const Options& options,
+                                         const QString& suffix,
+                                         int number) const
+{
+    const QString& fileName = number < 0
+                                  ? u"%1.%2"_s.arg(m_baseName, suffix)
+                                  : u"%1_%2.%3"_s.arg(m_baseName)
+                                        .arg(number, 4, 10, QLatin1Char('0'))
+                                        .arg(suffix);
+    return QDir(options.outputDirectory).filePath(fileName);
+}
+
+int LottieTranscoder::frameCount() const
+{
+    return m_frameCount;
+}
+
+QSize LottieTranscoder::size() const
+{
+    return m_size;
+}
+
+QString LottieTranscoder::errorString() const
+{
+    return m_errorString;
+}
@@ -0,0 +1,60 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QString>
+
+class LottieTranscoder final
+{
+    Q_DISABLE_COPY(LottieTranscoder)
+
+public:
+    struct Options
+    {
+        QString outputDirectory;
+        QByteArray format{"png"};
+        QSize scaledSize;
+        int firstFrame{0};
+        int lastFrame{-1};
+        int threadCount{0};
+        bool spriteSheet{false};
+        bool trim{true};
+        int maximumPageSize{4096};
+        int padding{1};
+    };
+
+    LottieTranscoder() = default;
+
+    bool load(const QString& filePath);
+    bool transcode(const Options& options);
+    int verifyRasterizer(const Options& options);
+
+    int frameCount() const;
+    QSize size() const;
+    QString errorString() const;
+
+private:
+    struct Frame
+    {
+        QImage image;
+        QPoint offset;
+    };
+
+    bool writeSpriteSheet(const Options& options,
+                          const QSize& frameSize,
+                          const QList<Frame>& frames);
+    QString outputFilePath(const Options& options,
+                           const QString& suffix,
+                           int number = -1) const;
+
+    QByteArray m_source;
+    QString m_baseName;
+    QString m_errorString;
+    QSize m_size;
+    int m_frameCount = 0;
+    int m_frameDelay = 0;
+};
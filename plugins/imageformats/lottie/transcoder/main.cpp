@@ -0,0 +1,128 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "lottietranscoder.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+
+using namespace Qt::Literals;
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(u"lottietranscoder"_s);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        u"Bakes lottie animations into image sequences or sprite sheets."_s);
+    parser.addHelpOption();
+    parser.addPositionalArgument(u"source"_s, u"The lottie file to transcode."_s);
+
+    const QCommandLineOption outputOption({u"o"_s, u"output"_s},
+                                          u"Output directory."_s,
+                                          u"directory"_s,
+                                          u"."_s);
+    const QCommandLineOption formatOption({u"f"_s, u"format"_s},
+                                          u"Image format (png, webp, ...)."_s,
+                                          u"format"_s,
+                                          u"png"_s);
+    const QCommandLineOption sizeOption({u"s"_s, u"size"_s},
+                                        u"Scaled frame size, e.g. 128x128."_s,
+                                        u"size"_s);
+    const QCommandLineOption firstOption(u"first"_s,
+                                         u"First frame to render."_s,
+                                         u"frame"_s,
+                                         u"0"_s);
+    const QCommandLineOption lastOption(u"last"_s,
+                                        u"Last frame to render."_s,
+                                        u"frame"_s,
+                                        u"-1"_s);
+    const QCommandLineOption threadsOption({u"j"_s, u"threads"_s},
+                                           u"Number of rendering threads."_s,
+                                           u"count"_s,
+                                           QString::number(
+                                               QThread::idealThreadCount()));
+    const QCommandLineOption spriteSheetOption(
+        u"sprite-sheet"_s,
+        u"Pack the frames into atlas pages with a json descriptor."_s);
+    const QCommandLineOption noTrimOption(
+        u"no-trim"_s,
+        u"Do not trim transparent borders of sprite sheet frames."_s);
+    const QCommandLineOption pageSizeOption(u"page-size"_s,
+                                            u"Maximum sprite sheet page size."_s,
+                                            u"pixels"_s,
+                                            u"4096"_s);
+    const QCommandLineOption paddingOption(u"padding"_s,
+                                           u"Padding between sprite sheet frames."_s,
+                                           u"pixels"_s,
+                                           u"1"_s);
+    const QCommandLineOption verifyOption(
+        u"verify-rasterizer"_s,
+        u"Compare the scanline rasterizer with QPainter instead of transcoding."_s,
+        u"tolerance"_s);
+    parser.addOptions({outputOption,
+                       formatOption,
+                       sizeOption,
+                       firstOption,
+                       lastOption,
+                       threadsOption,
+                       spriteSheetOption,
+                       noTrimOption,
+                       pageSizeOption,
+                       paddingOption,
+                       verifyOption});
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    LottieTranscoder::Options options;
+    options.outputDirectory = parser.value(outputOption);
+    options.format = parser.value(formatOption).toLatin1();
+    options.firstFrame = parser.value(firstOption).toInt();
+    options.lastFrame = parser.value(lastOption).toInt();
+    options.threadCount = parser.value(threadsOption).toInt();
+    options.spriteSheet = parser.isSet(spriteSheetOption);
+    options.trim = !parser.isSet(noTrimOption);
+    options.maximumPageSize = parser.value(pageSizeOption).toInt();
+    options.padding = parser.value(paddingOption).toInt();
+    if (parser.isSet(sizeOption)) {
+        const QStringList& size = parser.value(sizeOption).split(u'x');
+        if (size.size() == 2)
+            options.scaledSize = QSize(size[0].toInt(), size[1].toInt());
+        if (options.scaledSize.isEmpty()) {
+            qWarning("Invalid size: %s", qUtf8Printable(parser.value(sizeOption)));
+            return 1;
+        }
+    }
+
+    const QString& source = parser.positionalArguments().first();
+    LottieTranscoder transcoder;
+    if (!transcoder.load(source)) {
+        qWarning("%s", qUtf8Printable(transcoder.errorString()));
+        return 1;
+    }
+
+    if (parser.isSet(verifyOption)) {
+        const int difference = transcoder.verifyRasterizer(options);
+        if (difference < 0) {
+            qWarning("%s", qUtf8Printable(transcoder.errorString()));
+            return 1;
+        }
+        qInfo("Largest channel difference: %d", difference);
+        return difference > parser.value(verifyOption).toInt() ? 1 : 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!transcoder.transcode(options)) {
+        qWarning("%s", qUtf8Printable(transcoder.errorString()));
+        return 1;
+    }
+
+    qInfo("Transcoded %s in %lld ms", qUtf8Printable(source), timer.elapsed());
+    return 0;
+}
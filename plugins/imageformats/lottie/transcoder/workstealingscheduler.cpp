@@ -0,0 +1,107 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#include "workstealingscheduler.h"
+
+#include <QThread>
+
+WorkStealingScheduler::WorkStealingScheduler(int threadCount)
+    : m_threadCount(qMax(1, threadCount))
+{
+    for (int i = 0; i < m_threadCount; ++i)
+        m_ranges.push_back(std::make_unique<Range>());
+}
+
+int WorkStealingScheduler::threadCount() const
+{
+    return m_threadCount;
+}
+
+void WorkStealingScheduler::run(int begin, int end, const Task& task)
+{
+    if (end <= begin)
+        return;
+
+    // Hand out even slices up front, stealing fixes the imbalance later
+    const int count = end - begin;
+    for (int i = 0; i < m_threadCount; ++i) {
+        Range* range = m_ranges[i].get();
+        QMutexLocker locker(&range->mutex);
+        range->begin = begin + int(qint64(count) * i / m_threadCount);
+        range->end = begin + int(qint64(count) * (i + 1) / m_threadCount);
+    }
+
+    QList<QThread*> threads;
+    for (int i = 1; i < m_threadCount; ++i) {
+        QThread* thread = QThread::create([this, i, &task] { work(i, task); });
+        thread->start();
+        threads.append(thread);
+    }
+
+    work(0, task);
+
+    for (QThread* thread : std::as_const(threads)) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void WorkStealingScheduler::work(int worker, const Task& task)
+{
+    int index = 0;
+    while (takeFront(worker, &index) || steal(worker, &index))
+        task(worker, index);
+}
+
+bool WorkStealingScheduler::takeFront(int worker, int* index)
+{
+    Range* range = m_ranges[worker].get();
+    QMutexLocker locker(&range->mutex);
+    if (range->begin >= range->end)
+        return false;
+    *index = range->begin++;
+    return true;
+}
+
+bool WorkStealingScheduler::steal(int thief, int* index)
+{
+    forever {
+        // Pick the fullest victim, it may drain before it is locked again below
+        int victim = -1;
+        int largest = 0;
+        for (int i = 0; i < m_threadCount; ++i) {
+            if (i == thief)
+                continue;
+            Range* range = m_ranges[i].get();
+            QMutexLocker locker(&range->mutex);
+            const int remaining = range->end - range->begin;
+            if (remaining > largest) {
+                largest = remaining;
+                victim = i;
+            }
+        }
+
+        if (victim < 0)
+            return false;
+
+        int begin = 0;
+        int end = 0;
+        {
+            Range* range = m_ranges[victim].get();
+            QMutexLocker locker(&range->mutex);
+            const int remaining = range->end - range->begin;
+            if (remaining <= 0)
+                continue; // Drained in the meantime, look for another victim
+            begin = range->begin + remaining / 2;
+            end = range->end;
+            range->end = begin;
+        }
+
+        Range* own = m_ranges[thief].get();
+        QMutexLocker locker(&own->mutex);
+        own->begin = begin + 1;
+        own->end = end;
+        *index = begin;
+        return true;
+    }
+}
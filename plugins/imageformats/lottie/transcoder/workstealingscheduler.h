@@ -0,0 +1,44 @@
+// Copyright (C) 2024 Ömer Göktaş. All Rights Reserved.
+// SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
+
+#pragma once
+
+#include <QMutex>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+ * Runs a task for every index of a range on a fixed set of threads. Each worker
+ * owns a contiguous slice of the range and processes it front to back; a worker
+ * that runs dry steals the upper half of the largest remaining slice.
+*/
+
+class WorkStealingScheduler final
+{
+    Q_DISABLE_COPY(WorkStealingScheduler)
+
+public:
+    using Task = std::function<void(int worker, int index)>;
+
+    explicit WorkStealingScheduler(int threadCount);
+
+    int threadCount() const;
+    void run(int begin, int end, const Task& task);
+
+private:
+    struct Range
+    {
+        QMutex mutex;
+        int begin = 0;
+        int end = 0;
+    };
+
+    void work(int worker, const Task& task);
+    bool takeFront(int worker, int* index);
+    bool steal(int thief, int* index);
+
+    int m_threadCount;
+    std::vector<std::unique_ptr<Range>> m_ranges;
+};
@@ -2,7 +2,9 @@
 // SPDX-License-Identifier: LicenseRef-AcayipWidgets-Commercial OR GPL-3.0-only
 
 #include "utils_p.h"
+#include "plugins/iconengines/pixelperfect/pixelperfecticonengine.h"
 
+#include <private/qicon_p.h>
 #include <private/qlibrary_p.h>
 #include <private/qwidget_p.h>
 
@@ -84,6 +86,15 @@ QSize Utils::explicitWidgetMinMaxSize(const QWidget* widget, bool minimum)
     return WidgetHack::explicitMinMaxSize(widget, minimum);
 }
 
+const PixelPerfectIconEngine* Utils::pixelPerfectIconEngine(const QIcon& icon)
+{
+    QIcon copy(icon);
+    const QIconPrivate* d = copy.data_ptr();
+    if (!d || !d->engine || d->engine->key() != "PixelPerfectIconEngine"_L1)
+        return nullptr;
+    return static_cast<const PixelPerfectIconEngine*>(d->engine);
+}
+
 // FIXME: Put all plugin classes under Acayip namespace and make sure
 // they use global render settings too (i.e., like Defaults::renderHints)
 
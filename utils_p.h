@@ -5,12 +5,17 @@
 
 #include <acayipglobal.h>
 
+#include <QIcon>
+
+class PixelPerfectIconEngine;
+
 ACAYIPWIDGETS_BEGIN_NAMESPACE
 
 inline namespace Utils {
 
     void disableExistingIconEngines();
     QSize explicitWidgetMinMaxSize(const QWidget* widget, bool minimum);
+    const PixelPerfectIconEngine* pixelPerfectIconEngine(const QIcon& icon);
 
 } // namespace Utils
 